@@ -0,0 +1,110 @@
+#include "allocation_check.h"
+#include "allocation_counter.h"
+#include "color.h"
+#include "command_list.h"
+#include "frame_pipeline.h"
+#include "frame_presenter.h"
+#include "frame_timer.h"
+#include "matrix.h"
+#include "model.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "resolution.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <ghc/filesystem.hpp>
+#include <SDL2/SDL.h>
+
+namespace renderer {
+namespace {
+constexpr Color CHECK_CLEAR_COLOR {255, 255, 255, 255};
+constexpr float CHECK_FOV = 60.f;
+constexpr float CHECK_SCALE = 0.75f;
+constexpr size_t INSTANCE_ROWS = 4;
+// Frames that allocated after the warm-up, listed before the rest are summarized
+constexpr size_t MAX_REPORTED_FRAMES = 10;
+}
+
+int run_allocation_check(const AllocationCheckOptions& options) {
+    std::unique_ptr<Model> model;
+    try {
+        ModelOptions model_options;
+        model_options.build_lods = true;
+        model_options.build_meshlets = true;
+        model = std::make_unique<Model>((ghc::filesystem::path(options.data_dir) / "Pallas_Cat").string(), model_options);
+    } catch (const std::runtime_error& error) {
+        std::cout << "Runtime Error: " << error.what() << std::endl;
+        return 1;
+    }
+
+    Renderer renderer(CHECK_CLEAR_COLOR);
+    FramePipeline frame_pipeline(renderer, true);
+    std::vector<uint32_t> window_pixels(static_cast<size_t>(options.width) * options.height);
+    FramePresenter presenter(3, options.width, options.height, [&](const RenderTarget& target) {
+        target.copy_to(window_pixels.data(), options.width * sizeof(uint32_t));
+    });
+    FrameTimer frame_timer(SDL_GetPerformanceCounter, SDL_GetPerformanceFrequency());
+    const FogShader fog_shader(model->get_texels(), CHECK_CLEAR_COLOR, 35.f, 70.f);
+
+    uint16_t scaled_width;
+    uint16_t scaled_height;
+    ResolutionController::get_scaled_size(options.width, options.height, CHECK_SCALE, scaled_width, scaled_height);
+    RenderTarget scaled_target(scaled_width, scaled_height);
+
+    CommandList command_list;
+    std::vector<math::Matrix<4, 4>> instance_matrices(INSTANCE_ROWS * INSTANCE_ROWS);
+    const math::Matrix<4, 4> tilt_mtx = math::create_rotation_matrix(1.f, 0.f, 0.f, 1.6f);
+    const math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
+
+    uint64_t warmup_allocations = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    size_t allocating_frames = 0;
+    for (size_t frame = 0; frame < options.frame_count; frame++) {
+        const AllocationCounts start = get_allocation_counts();
+
+        RenderTarget& target = presenter.acquire(options.width, options.height);
+        const math::Matrix<4, 4> rotation_mtx = math::mul(tilt_mtx, math::create_rotation_matrix(0.f, 0.f, 1.f, frame * 0.05f));
+        for (size_t i = 0; i < instance_matrices.size(); i++) {
+            const float x = (static_cast<float>(i % INSTANCE_ROWS) - INSTANCE_ROWS / 2.f) * 30.f;
+            const float z = 80.f + static_cast<float>(i / INSTANCE_ROWS) * 30.f;
+            instance_matrices[i] = math::mul(math::create_translation_matrix(x, -20.f, z), rotation_mtx);
+        }
+
+        command_list.reset();
+        command_list.clear();
+        command_list.draw_model(model.get(), rotation_mtx, translation_mtx, CHECK_FOV);
+        command_list.draw_model_instanced(model.get(), instance_matrices.data(), instance_matrices.size(), CHECK_FOV);
+        frame_pipeline.submit(command_list, scaled_target);
+        frame_pipeline.flush(scaled_target);
+        renderer.draw_model_shaded(model.get(), scaled_target, math::mul(translation_mtx, rotation_mtx), CHECK_FOV, fog_shader);
+        upscale(scaled_target, target, UpscaleFilter::Bilinear);
+        presenter.submit(target);
+        frame_timer.end_frame();
+        frame_timer.get_stats();
+
+        const AllocationCounts end = get_allocation_counts();
+        const uint64_t frame_allocations = end.allocations - start.allocations;
+        if (frame < options.warmup_frames) {
+            warmup_allocations += frame_allocations;
+        } else if (frame_allocations > 0) {
+            if (allocating_frames < MAX_REPORTED_FRAMES) {
+                std::cout << "frame " << frame << " made " << frame_allocations << " allocations of " << end.bytes - start.bytes << " bytes" << std::endl;
+            }
+            allocating_frames++;
+            allocations += frame_allocations;
+            allocated_bytes += end.bytes - start.bytes;
+        }
+    }
+    presenter.finish();
+
+    std::cout << warmup_allocations << " allocations in " << std::min(options.warmup_frames, options.frame_count) << " warm-up frames, "
+              << allocations << " allocations of " << allocated_bytes << " bytes in " << allocating_frames << " of the "
+              << options.frame_count - std::min(options.warmup_frames, options.frame_count) << " frames after" << std::endl;
+    return allocations == 0 ? 0 : 1;
+}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace renderer {
+struct AllocationCheckOptions {
+    std::string data_dir;
+    size_t frame_count = 300;
+    // Frames that may allocate while the reused buffers grow to their steady state size
+    size_t warmup_frames = 30;
+    uint16_t width = 800;
+    uint16_t height = 600;
+};
+
+// Renders frames the way the viewer does, pipelined geometry, instanced and shaded draws, a scaled target upscaled into
+// a pool of presented targets, and counts the heap allocations of every frame. Any allocation after the warm-up is a
+// regression, the frames that allocated are printed. Returns the process exit code.
+int run_allocation_check(const AllocationCheckOptions& options);
+}
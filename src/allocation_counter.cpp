@@ -0,0 +1,114 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace renderer {
+namespace {
+std::atomic<uint64_t> allocation_count {0};
+std::atomic<uint64_t> allocated_bytes {0};
+
+void* allocate(size_t size, size_t alignment) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+void deallocate(void* pointer, size_t alignment) {
+#ifdef _WIN32
+    if (alignment > alignof(std::max_align_t)) {
+        _aligned_free(pointer);
+        return;
+    }
+#else
+    (void) alignment;
+#endif
+    std::free(pointer);
+}
+
+void* allocate_or_throw(size_t size, size_t alignment) {
+    void* pointer = allocate(size, alignment);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+}
+
+AllocationCounts get_allocation_counts() {
+    return AllocationCounts {allocation_count.load(std::memory_order_relaxed), allocated_bytes.load(std::memory_order_relaxed)};
+}
+}
+
+void* operator new(size_t size) {
+    return renderer::allocate_or_throw(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size) {
+    return renderer::allocate_or_throw(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return renderer::allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return renderer::allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return renderer::allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return renderer::allocate(size, alignof(std::max_align_t));
+}
+
+void operator delete(void* pointer) noexcept {
+    renderer::deallocate(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void* pointer) noexcept {
+    renderer::deallocate(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    renderer::deallocate(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    renderer::deallocate(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void* pointer, std::align_val_t alignment) noexcept {
+    renderer::deallocate(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept {
+    renderer::deallocate(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+    renderer::deallocate(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept {
+    renderer::deallocate(pointer, static_cast<size_t>(alignment));
+}
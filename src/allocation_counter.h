@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+namespace renderer {
+// Heap allocations made through operator new by every thread since the start, counted by the replacement allocation
+// functions in allocation_counter.cpp. Allocations by C libraries like SDL, which go through malloc, are not counted.
+struct AllocationCounts {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+AllocationCounts get_allocation_counts();
+}
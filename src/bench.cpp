@@ -0,0 +1,299 @@
+#include "bench.h"
+#include "frustum.h"
+#include "matrix.h"
+#include "quantization.h"
+#include "renderer.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+namespace {
+constexpr size_t BENCH_INPUTS = 256;
+constexpr size_t BENCH_VERTICES = 4096;
+constexpr size_t BENCH_SAMPLES = 21;
+constexpr double BENCH_SAMPLE_SECONDS = 0.01;
+
+struct BenchResult {
+    std::string name;
+    double median_ns;
+    double min_ns;
+    // Median absolute deviation relative to the median
+    double spread;
+};
+
+// Keeps the compiler from dropping the benchmarked work
+volatile float sink = 0.f;
+
+// A fixed seed keeps the inputs, and therefore any data dependent timing, the same between runs
+class Random {
+public:
+    float next(float min, float max) {
+        state = state * 1664525u + 1013904223u;
+        return min + (max - min) * static_cast<float>(state >> 8) / static_cast<float>(1u << 24);
+    }
+private:
+    uint32_t state = 12345u;
+};
+
+// Calls the kernel in batches sized to take about BENCH_SAMPLE_SECONDS each and reports per-operation statistics
+template <typename Kernel>
+BenchResult run_benchmark(const std::string& name, size_t operations, Kernel&& kernel) {
+    using clock = std::chrono::steady_clock;
+
+    size_t iterations = 1;
+    while (true) {
+        const auto start = clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            kernel();
+        }
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds >= BENCH_SAMPLE_SECONDS) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    for (size_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        const auto start = clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            kernel();
+        }
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        samples.push_back(seconds * 1e9 / static_cast<double>(iterations * operations));
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const double median = samples[samples.size() / 2];
+    std::vector<double> deviations;
+    for (double sample : samples) {
+        deviations.push_back(std::abs(sample - median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    return BenchResult {name, median, samples.front(), deviations[deviations.size() / 2] / median};
+}
+
+std::vector<math::Matrix<4, 4>> create_matrices(Random& random) {
+    std::vector<math::Matrix<4, 4>> matrices(BENCH_INPUTS);
+    for (math::Matrix<4, 4>& mtx : matrices) {
+        for (float& value : mtx.data) {
+            value = random.next(-1.f, 1.f);
+        }
+    }
+    return matrices;
+}
+
+// The same steps as Renderer::transform_vertex without the post-transform cache, which hides the cost on shared vertices
+template <typename VertexType>
+BenchResult run_transform_benchmark(const std::string& name, const std::vector<VertexType>& vertex_buffer, const Quantization& quantization,
+                                    const math::Matrix<4, 4>& mtx) {
+    std::vector<TransformedVertex> transformed(vertex_buffer.size());
+    return run_benchmark(name, vertex_buffer.size(), [&]() {
+        for (size_t i = 0; i < vertex_buffer.size(); i++) {
+            const Vertex& vertex = unpack_vertex(vertex_buffer[i], quantization);
+            const math::Vector<4> vector = math::mul(mtx, vertex.xyzw);
+            TransformedVertex& out = transformed[i];
+            out.clip_code = get_clip_code(vector);
+            out.vertex = vertex;
+            out.vertex.x = (vector.data[0] / vector.data[3] + 1.f) / 2.f;
+            out.vertex.y = (vector.data[1] / vector.data[3] + 1.f) / 2.f;
+            out.vertex.z = vector.data[2] / vector.data[3];
+            out.vertex.w = vector.data[3];
+        }
+        sink = transformed[BENCH_VERTICES / 2].vertex.x;
+    });
+}
+
+std::vector<BenchResult> run_benchmarks() {
+    std::vector<BenchResult> results;
+    Random random;
+
+    const std::vector<math::Matrix<4, 4>> matrices = create_matrices(random);
+    std::vector<math::Vector<4>> vectors(BENCH_INPUTS);
+    for (math::Vector<4>& vector : vectors) {
+        vector = {random.next(-10.f, 10.f), random.next(-10.f, 10.f), random.next(-10.f, 10.f), 1.f};
+    }
+
+    std::vector<math::Matrix<4, 4>> matrix_products(BENCH_INPUTS);
+    results.push_back(run_benchmark("mul_4x4_4x4", BENCH_INPUTS, [&]() {
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            matrix_products[i] = math::mul(matrices[i], matrices[(i + 1) % BENCH_INPUTS]);
+        }
+        sink = matrix_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    // The generic template, for comparison with the 4x4 overloads
+    results.push_back(run_benchmark("mul_4x4_4x4_generic", BENCH_INPUTS, [&]() {
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            matrix_products[i] = math::mul<4, 4, 4, 4>(matrices[i], matrices[(i + 1) % BENCH_INPUTS]);
+        }
+        sink = matrix_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    std::vector<math::Vector<4>> vector_products(BENCH_INPUTS);
+    results.push_back(run_benchmark("mul_4x4_vec4", BENCH_INPUTS, [&]() {
+        const math::Matrix<4, 4>& mtx = matrices[0];
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            vector_products[i] = math::mul(mtx, vectors[i]);
+        }
+        sink = vector_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    results.push_back(run_benchmark("mul_4x4_vec4_generic", BENCH_INPUTS, [&]() {
+        const math::Matrix<4, 4>& mtx = matrices[0];
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            vector_products[i] = math::mul<4, 4, 1, 4>(mtx, vectors[i]);
+        }
+        sink = vector_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    results.push_back(run_benchmark("mul_4x4_vec4_batch", BENCH_INPUTS, [&]() {
+        math::mul(matrices[0], vectors.data(), vector_products.data(), BENCH_INPUTS);
+        sink = vector_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    // A cloud of vertices in front of the camera, so that the clip codes are a realistic mix
+    const math::Matrix<4, 4> projection_mtx = math::create_projection_matrix(800, 600, 0.01f, 100.f, 60.f);
+    const math::Matrix<4, 4> model_mtx = math::mul(math::create_translation_matrix(0.f, 0.f, 30.f),
+                                                   math::create_rotation_matrix(0.f, 1.f, 0.f, 0.5f));
+    const math::Matrix<4, 4> mtx = math::mul(projection_mtx, model_mtx);
+    std::vector<Vertex> vertex_buffer(BENCH_VERTICES);
+    for (Vertex& vertex : vertex_buffer) {
+        vertex = Vertex {random.next(-20.f, 20.f), random.next(-15.f, 15.f), random.next(-10.f, 10.f), 1.f, random.next(0.f, 1.f), random.next(0.f, 1.f)};
+    }
+    results.push_back(run_transform_benchmark("transform_vertex", vertex_buffer, Quantization {}, mtx));
+
+    BoundingBox bounding_box {{-20.f, -15.f, -10.f}, {20.f, 15.f, 10.f}};
+    const float uv_min[2] = {0.f, 0.f};
+    const float uv_max[2] = {1.f, 1.f};
+    const Quantization quantization = create_quantization(bounding_box, uv_min, uv_max);
+    std::vector<QuantizedVertex> quantized_vertex_buffer;
+    for (const Vertex& vertex : vertex_buffer) {
+        quantized_vertex_buffer.push_back(quantize_vertex(vertex, quantization));
+    }
+    const math::Matrix<4, 4> quantized_mtx = math::mul(mtx, get_dequantization_matrix(quantization));
+    results.push_back(run_transform_benchmark("transform_vertex_quantized", quantized_vertex_buffer, quantization, quantized_mtx));
+
+    std::vector<float> angles(BENCH_INPUTS);
+    for (float& angle : angles) {
+        angle = random.next(0.f, 2.f * math::PI);
+    }
+
+    results.push_back(run_benchmark("create_projection_matrix", BENCH_INPUTS, [&]() {
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            matrix_products[i] = math::create_projection_matrix(800, 600, 0.01f, 100.f, 30.f + angles[i]);
+        }
+        sink = matrix_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    results.push_back(run_benchmark("create_rotation_matrix", BENCH_INPUTS, [&]() {
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            matrix_products[i] = math::create_rotation_matrix(0.f, 0.f, 1.f, angles[i]);
+        }
+        sink = matrix_products[BENCH_INPUTS / 2].data[0];
+    }));
+
+    // Everything Renderer::draw_model does per draw before touching a vertex
+    results.push_back(run_benchmark("draw_setup", BENCH_INPUTS, [&]() {
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            const math::Matrix<4, 4> rotation_mtx = math::mul(math::create_rotation_matrix(1.f, 0.f, 0.f, 1.6f),
+                                                              math::create_rotation_matrix(0.f, 0.f, 1.f, angles[i]));
+            const math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
+            const math::Matrix<4, 4> draw_mtx = math::mul(math::create_projection_matrix(800, 600, 0.01f, 100.f, 60.f),
+                                                          math::mul(translation_mtx, rotation_mtx));
+            const Frustum frustum(draw_mtx);
+            matrix_products[i] = draw_mtx;
+            sink = static_cast<float>(frustum.classify(bounding_box));
+        }
+    }));
+
+    return results;
+}
+
+// The comparison uses the fastest sample, which is the least disturbed by other load on the machine
+std::unordered_map<std::string, double> load_baseline(const std::string& path) {
+    std::unordered_map<std::string, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream stream(line);
+        std::string name;
+        double median_ns;
+        double min_ns;
+        if (stream >> name >> median_ns >> min_ns) {
+            baseline[name] = min_ns;
+        }
+    }
+    return baseline;
+}
+
+bool save_baseline(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream file(path);
+    file << "# benchmark median_ns min_ns" << std::endl;
+    for (const BenchResult& result : results) {
+        file << result.name << " " << std::setprecision(6) << result.median_ns << " " << result.min_ns << std::endl;
+    }
+    return file.good();
+}
+}
+
+int run_bench(const BenchOptions& options) {
+    std::unordered_map<std::string, double> baseline;
+    if (!options.compare_path.empty()) {
+        baseline = load_baseline(options.compare_path);
+        if (baseline.empty()) {
+            std::cerr << "Failed to read a baseline from " << options.compare_path << std::endl;
+            return 1;
+        }
+    }
+
+    const std::vector<BenchResult> results = run_benchmarks();
+
+    size_t regressions = 0;
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(12) << "median ns" << std::setw(12) << "min ns"
+              << std::setw(10) << "spread" << (baseline.empty() ? "" : "  baseline min  change") << std::endl;
+    for (const BenchResult& result : results) {
+        std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << result.median_ns << std::setw(12) << result.min_ns
+                  << std::setprecision(1) << std::setw(9) << result.spread * 100. << "%";
+
+        const auto it = baseline.find(result.name);
+        if (it != baseline.end()) {
+            const double change = (result.min_ns / it->second - 1.) * 100.;
+            std::cout << std::setprecision(3) << std::setw(14) << it->second << std::showpos << std::setprecision(1)
+                      << std::setw(7) << change << "%" << std::noshowpos;
+            if (change > options.max_regression) {
+                regressions++;
+                std::cout << "  REGRESSED";
+            }
+        }
+        std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+
+    if (!options.save_path.empty()) {
+        if (!save_baseline(options.save_path, results)) {
+            std::cerr << "Failed to write a baseline to " << options.save_path << std::endl;
+            return 1;
+        }
+        std::cout << "Baseline saved to " << options.save_path << std::endl;
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " benchmarks regressed by more than " << options.max_regression << "%" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+}
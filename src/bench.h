@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace renderer {
+struct BenchOptions {
+    // A baseline written by a previous run to compare against, empty skips the comparison
+    std::string compare_path;
+    // Where to write the results of this run, empty skips saving
+    std::string save_path;
+    // How much slower than the baseline, in percent, the fastest sample of a benchmark may get before the run fails
+    float max_regression = 10.f;
+};
+
+// Times the math and transform kernels and prints the median, minimum and spread of each. Returns the process exit code.
+int run_bench(const BenchOptions& options);
+}
@@ -0,0 +1,53 @@
+#include "command_list.h"
+
+namespace renderer {
+void CommandList::clear() {
+    commands.push_back(Command {CommandType::Clear});
+}
+
+void CommandList::draw_model(const Model* model, const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov) {
+    const math::Matrix<4, 4> model_mtx = math::mul(translation_mtx, rotation_mtx);
+    draw_model_instanced(model, &model_mtx, 1, fov);
+}
+
+void CommandList::draw_model_instanced(const Model* model, const math::Matrix<4, 4>* model_matrices, size_t instance_count, float fov) {
+    Command command = {CommandType::DrawModel};
+    command.value = fov;
+    command.model = model;
+    command.first_matrix = static_cast<uint32_t>(matrices.size());
+    command.matrix_count = static_cast<uint32_t>(instance_count);
+    commands.push_back(command);
+    matrices.insert(matrices.end(), model_matrices, model_matrices + instance_count);
+}
+
+const std::vector<Command>& CommandList::get_commands() const {
+    return commands;
+}
+
+const std::vector<math::Matrix<4, 4>>& CommandList::get_matrices() const {
+    return matrices;
+}
+
+void CommandList::reset() {
+    commands.clear();
+    matrices.clear();
+}
+
+void CommandList::set_clear_color(Color color) {
+    Command command = {CommandType::SetClearColor};
+    command.color = color;
+    commands.push_back(command);
+}
+
+void CommandList::set_lod_density(float triangles_per_pixel) {
+    Command command = {CommandType::SetLodDensity};
+    command.value = triangles_per_pixel;
+    commands.push_back(command);
+}
+
+void CommandList::set_pipeline_state(const PipelineState& state) {
+    Command command = {CommandType::SetPipelineState};
+    command.pipeline_state = state;
+    commands.push_back(command);
+}
+}
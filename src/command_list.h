@@ -0,0 +1,49 @@
+#pragma once
+
+#include "color.h"
+#include "matrix.h"
+#include "pipeline.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer {
+class Model;
+
+enum class CommandType : uint8_t {
+    Clear,
+    DrawModel,
+    SetClearColor,
+    SetLodDensity,
+    SetPipelineState
+};
+
+struct Command {
+    CommandType type;
+    Color color;
+    float value;
+    PipelineState pipeline_state;
+    const Model* model;
+    uint32_t first_matrix;
+    uint32_t matrix_count;
+};
+
+// Records renderer commands for a later submit. Recording never touches a buffer, and the list is not consumed
+// by a submit, so a static list can be replayed every frame.
+class CommandList {
+public:
+    void clear();
+    void draw_model(const Model* model, const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov);
+    void draw_model_instanced(const Model* model, const math::Matrix<4, 4>* model_matrices, size_t instance_count, float fov);
+    const std::vector<Command>& get_commands() const;
+    const std::vector<math::Matrix<4, 4>>& get_matrices() const;
+    // Drops the recorded commands but keeps the storage for the next recording
+    void reset();
+    void set_clear_color(Color color);
+    void set_lod_density(float triangles_per_pixel);
+    void set_pipeline_state(const PipelineState& state);
+private:
+    std::vector<Command> commands;
+    std::vector<math::Matrix<4, 4>> matrices;
+};
+}
@@ -0,0 +1,110 @@
+#include "cpu.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define CPU_X86
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_X86
+#include <cpuid.h>
+#endif
+
+namespace renderer {
+namespace {
+#if defined(CPU_X86)
+struct CpuidRegisters {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+};
+
+CpuidRegisters cpuid(uint32_t leaf, uint32_t subleaf) {
+    CpuidRegisters registers {};
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    registers = {static_cast<uint32_t>(values[0]), static_cast<uint32_t>(values[1]), static_cast<uint32_t>(values[2]), static_cast<uint32_t>(values[3])};
+#else
+    __cpuid_count(leaf, subleaf, registers.eax, registers.ebx, registers.ecx, registers.edx);
+#endif
+    return registers;
+}
+
+// The register state the operating system saves on a context switch
+uint64_t xgetbv() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax;
+    uint32_t edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return static_cast<uint64_t>(edx) << 32 | eax;
+#endif
+}
+#endif
+
+CpuLevel detect_cpu_level() {
+#if defined(CPU_X86)
+    const uint32_t max_leaf = cpuid(0, 0).eax;
+    const CpuidRegisters features = cpuid(1, 0);
+    const bool has_sse42 = (features.ecx & (1u << 20)) != 0;
+    if (!has_sse42) {
+        return CpuLevel::Scalar;
+    }
+
+    const bool has_osxsave = (features.ecx & (1u << 27)) != 0;
+    const bool has_avx = (features.ecx & (1u << 28)) != 0;
+    if (!has_osxsave || !has_avx || max_leaf < 7) {
+        return CpuLevel::SSE42;
+    }
+
+    // XMM and YMM state, then the opmask and both halves of the ZMM state
+    const uint64_t xcr0 = xgetbv();
+    const bool os_avx = (xcr0 & 0x06) == 0x06;
+    const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+    const CpuidRegisters extended_features = cpuid(7, 0);
+    const bool has_avx2 = (extended_features.ebx & (1u << 5)) != 0;
+    const bool has_avx512f = (extended_features.ebx & (1u << 16)) != 0;
+    if (has_avx512f && has_avx2 && os_avx512) {
+        return CpuLevel::AVX512;
+    }
+    if (has_avx2 && os_avx) {
+        return CpuLevel::AVX2;
+    }
+    return CpuLevel::SSE42;
+#else
+    return CpuLevel::Scalar;
+#endif
+}
+}
+
+CpuLevel get_cpu_level() {
+    static const CpuLevel level = detect_cpu_level();
+    return level;
+}
+
+const char* get_cpu_level_name(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::Scalar:
+            return "scalar";
+        case CpuLevel::SSE42:
+            return "sse4.2";
+        case CpuLevel::AVX2:
+            return "avx2";
+        case CpuLevel::AVX512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+bool parse_cpu_level(const std::string& name, CpuLevel& level) {
+    for (CpuLevel candidate : {CpuLevel::Scalar, CpuLevel::SSE42, CpuLevel::AVX2, CpuLevel::AVX512}) {
+        if (name == get_cpu_level_name(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace renderer {
+// Instruction set levels the kernels are specialized for, each one implies the ones before it
+enum class CpuLevel : uint8_t {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+// The highest level supported by both the processor and the operating system, detected with cpuid
+CpuLevel get_cpu_level();
+const char* get_cpu_level_name(CpuLevel level);
+bool parse_cpu_level(const std::string& name, CpuLevel& level);
+}
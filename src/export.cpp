@@ -0,0 +1,256 @@
+#include "export.h"
+#include "color.h"
+#include "frame_stream.h"
+#include "frame_writer.h"
+#include "matrix.h"
+#include "model.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "resolution.h"
+#include "shared_frames.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <ghc/filesystem.hpp>
+
+namespace renderer {
+namespace {
+constexpr Color EXPORT_CLEAR_COLOR {255, 255, 255, 255};
+constexpr float EXPORT_FOV = 60.f;
+// Frames per turn of an endless stream
+constexpr size_t STREAM_TURN_FRAMES = 240;
+
+// Set by Ctrl+C, so that the shared memory of an endless run is still unlinked
+std::atomic<bool> stop_requested {false};
+
+void request_stop(int) {
+    stop_requested = true;
+}
+
+// The camera path of the viewer, turn goes from 0 to 1 over a full turn
+math::Matrix<4, 4> get_turntable_rotation(float turn) {
+    const math::Matrix<4, 4> tilt_mtx = math::create_rotation_matrix(1.f, 0.f, 0.f, 1.6f);
+    return math::mul(tilt_mtx, math::create_rotation_matrix(0.f, 0.f, 1.f, 2.f * math::PI * turn));
+}
+
+int read_shared_frames(const SharedFramesOptions& options) {
+    // The renderer may still be starting up
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::seconds(10);
+    std::unique_ptr<SharedFrameReader> reader = std::make_unique<SharedFrameReader>(options.name);
+    while (!reader->is_open() && clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        reader = std::make_unique<SharedFrameReader>(options.name);
+    }
+    if (!reader->is_open()) {
+        std::cerr << "No shared frames found at " << options.name << std::endl;
+        return 1;
+    }
+
+    const uint16_t width = reader->get_width();
+    const uint16_t height = reader->get_height();
+    std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+    uint64_t frame_counter = 0;
+    uint64_t frames_read = 0;
+    uint64_t frames_missed = 0;
+    uint64_t torn_reads = 0;
+    const auto start = clock::now();
+    while (options.frame_count == 0 || frames_read < options.frame_count) {
+        const uint64_t previous_counter = frame_counter;
+        if (reader->read_latest(frame_counter, pixels.data(), width * sizeof(uint32_t), torn_reads)) {
+            frames_missed += previous_counter > 0 ? frame_counter - previous_counter - 1 : 0;
+            frames_read++;
+        } else if (reader->is_closed()) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+    const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(1)
+              << frames_read << " frames of " << width << "x" << height << " read from " << options.name << " at " << frames_read / seconds
+              << " FPS, " << frames_missed << " missed, " << torn_reads << " overwritten while reading" << std::endl
+              << std::defaultfloat << std::setprecision(6);
+
+    if (!options.output_dir.empty() && frames_read > 0) {
+        std::error_code error_code;
+        ghc::filesystem::create_directories(options.output_dir, error_code);
+        FrameWriter writer(options.output_dir, ImageFormat::Bmp, width, height, 1);
+        uint32_t* frame = writer.acquire();
+        std::copy(pixels.begin(), pixels.end(), frame);
+        writer.submit(frame);
+        if (!writer.finish()) {
+            return 1;
+        }
+    }
+    return frames_read > 0 ? 0 : 1;
+}
+
+std::unique_ptr<Model> load_model(const std::string& data_dir) {
+    try {
+        return std::make_unique<Model>((ghc::filesystem::path(data_dir) / "Pallas_Cat").string());
+    } catch (const std::runtime_error& error) {
+        std::cout << "Runtime Error: " << error.what() << std::endl;
+        return nullptr;
+    }
+}
+}
+
+int run_export(const ExportOptions& options) {
+    const std::unique_ptr<Model> model = load_model(options.data_dir);
+    if (model == nullptr) {
+        return 1;
+    }
+
+    std::error_code error_code;
+    ghc::filesystem::create_directories(options.output_dir, error_code);
+    if (error_code) {
+        std::cerr << "Failed to create " << options.output_dir << ": " << error_code.message() << std::endl;
+        return 1;
+    }
+
+    Renderer renderer(EXPORT_CLEAR_COLOR);
+    RenderTarget target(options.width, options.height);
+    FrameWriter writer(options.output_dir, options.format, options.width, options.height, options.queue_depth);
+    const bool dynamic_resolution = options.frame_budget_ms > 0.;
+    ResolutionController resolution_controller(options.frame_budget_ms / 1000.);
+    RenderTarget scaled_target(options.width, options.height);
+
+    const math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    double render_seconds = 0.;
+    for (size_t frame = 0; frame < options.frame_count; frame++) {
+        const auto render_start = clock::now();
+        const math::Matrix<4, 4> rotation_mtx = get_turntable_rotation(static_cast<float>(frame) / options.frame_count);
+        if (dynamic_resolution) {
+            const float scale = resolution_controller.get_scale();
+            uint16_t scaled_width;
+            uint16_t scaled_height;
+            ResolutionController::get_scaled_size(options.width, options.height, scale, scaled_width, scaled_height);
+            if (scaled_target.get_width() != scaled_width || scaled_target.get_height() != scaled_height) {
+                scaled_target.resize(scaled_width, scaled_height);
+            }
+
+            renderer.clear_buffer(scaled_target);
+            renderer.draw_model(model.get(), scaled_target, rotation_mtx, translation_mtx, EXPORT_FOV);
+            const double frame_seconds = std::chrono::duration<double>(clock::now() - render_start).count();
+            resolution_controller.update(frame_seconds);
+            upscale(scaled_target, target, options.upscale_filter);
+            std::cout << std::fixed << std::setprecision(2) << "frame " << frame << " scale " << scale << " (" << scaled_width << "x" << scaled_height
+                      << ") rendered in " << frame_seconds * 1000. << " ms" << std::endl << std::defaultfloat << std::setprecision(6);
+        } else {
+            renderer.clear_buffer(target);
+            renderer.draw_model(model.get(), target, rotation_mtx, translation_mtx, EXPORT_FOV);
+        }
+        render_seconds += std::chrono::duration<double>(clock::now() - render_start).count();
+
+        uint32_t* pixels = writer.acquire();
+        target.copy_to(pixels, options.width * sizeof(uint32_t));
+        writer.submit(pixels);
+    }
+    const bool written = writer.finish();
+    const double total_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    const FrameWriterStats stats = writer.get_stats();
+    std::cout << std::fixed << std::setprecision(1)
+              << stats.frames_written << " of " << options.frame_count << " frames written to " << options.output_dir
+              << " as " << get_image_format_extension(options.format) << ", " << stats.bytes_written / (1024. * 1024.) << " MiB" << std::endl
+              << "end to end " << options.frame_count / total_seconds << " FPS, rendering alone " << options.frame_count / render_seconds
+              << " FPS, waited for the disk " << stats.stalls << " times for " << stats.stall_seconds * 1000. << " ms" << std::endl
+              << std::defaultfloat << std::setprecision(6);
+    return written ? 0 : 1;
+}
+
+int run_stream(const StreamOptions& options) {
+    // Opened first, so that everything printed from here on stays out of stdout
+    FrameStream stream(options.output, options.width, options.height);
+    const std::unique_ptr<Model> model = load_model(options.data_dir);
+    if (model == nullptr) {
+        return 1;
+    }
+
+    Renderer renderer(EXPORT_CLEAR_COLOR);
+    const math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
+    const size_t turn_frames = options.frame_count > 0 ? options.frame_count : STREAM_TURN_FRAMES;
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    double render_seconds = 0.;
+    size_t frame = 0;
+    for (; (options.frame_count == 0 || frame < options.frame_count) && !stream.has_failed(); frame++) {
+        RenderTarget& target = stream.acquire();
+        const auto render_start = clock::now();
+        const math::Matrix<4, 4> rotation_mtx = get_turntable_rotation(static_cast<float>(frame % turn_frames) / turn_frames);
+        renderer.clear_buffer(target);
+        renderer.draw_model(model.get(), target, rotation_mtx, translation_mtx, EXPORT_FOV);
+        render_seconds += std::chrono::duration<double>(clock::now() - render_start).count();
+        stream.submit();
+    }
+    // A reader closing the pipe of an endless stream is the normal way to stop it
+    const bool finished = stream.finish();
+    const double total_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    const FrameStreamStats stats = stream.get_stats();
+    const bool written = finished || (options.frame_count == 0 && stats.frames_written > 0);
+    std::cerr << std::fixed << std::setprecision(1)
+              << stats.frames_written << " frames of " << options.width << "x" << options.height << " BGRA streamed to "
+              << (options.output == "-" ? "stdout" : options.output) << ", " << stats.bytes_written / (1024. * 1024.) << " MiB in "
+              << stats.write_calls << " writes, " << stats.partial_writes << " partial" << std::endl
+              << "end to end " << frame / total_seconds << " FPS, rendering alone " << frame / render_seconds
+              << " FPS, writing took " << stats.write_seconds * 1000. << " ms, waited for the reader " << stats.stalls
+              << " times for " << stats.stall_seconds * 1000. << " ms" << std::endl
+              << std::defaultfloat << std::setprecision(6);
+    return written ? 0 : 1;
+}
+
+int run_shared_frames(const SharedFramesOptions& options) {
+    if (options.reader) {
+        return read_shared_frames(options);
+    }
+
+    const std::unique_ptr<Model> model = load_model(options.data_dir);
+    if (model == nullptr) {
+        return 1;
+    }
+    SharedFrameRing ring(options.name, options.width, options.height, options.slot_count);
+    if (!ring.is_open()) {
+        return 1;
+    }
+
+    Renderer renderer(EXPORT_CLEAR_COLOR);
+    const math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
+    const size_t turn_frames = options.frame_count > 0 ? options.frame_count : STREAM_TURN_FRAMES;
+    std::cout << "Rendering into " << options.name << ", read it with --shm-read --name " << options.name << std::endl;
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    for (size_t frame = 0; (options.frame_count == 0 || frame < options.frame_count) && !stop_requested; frame++) {
+        RenderTarget& target = ring.begin_frame();
+        const math::Matrix<4, 4> rotation_mtx = get_turntable_rotation(static_cast<float>(frame % turn_frames) / turn_frames);
+        renderer.clear_buffer(target);
+        renderer.draw_model(model.get(), target, rotation_mtx, translation_mtx, EXPORT_FOV);
+        ring.end_frame();
+
+        if (options.fps > 0) {
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(static_cast<double>(frame + 1) / options.fps));
+        }
+    }
+    const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(1)
+              << ring.get_frame_counter() << " frames published to " << options.name << " at " << ring.get_frame_counter() / seconds << " FPS" << std::endl
+              << std::defaultfloat << std::setprecision(6);
+    return 0;
+}
+}
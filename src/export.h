@@ -0,0 +1,64 @@
+#pragma once
+
+#include "frame_writer.h"
+#include "resolution.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace renderer {
+struct ExportOptions {
+    std::string data_dir;
+    std::string output_dir = "frames";
+    size_t frame_count = 120;
+    ImageFormat format = ImageFormat::Ppm;
+    uint16_t width = 800;
+    uint16_t height = 600;
+    // Frames that may wait for the I/O thread before rendering waits too
+    size_t queue_depth = 4;
+    // Renders at a resolution scaled to hold this render time per frame and upscales the result, 0 renders at full size
+    double frame_budget_ms = 0.;
+    UpscaleFilter upscale_filter = UpscaleFilter::Bilinear;
+};
+
+struct StreamOptions {
+    std::string data_dir;
+    // "-" for stdout, or a file, usually a named pipe
+    std::string output = "-";
+    // 0 streams until the reader closes the pipe
+    size_t frame_count = 0;
+    uint16_t width = 800;
+    uint16_t height = 600;
+};
+
+struct SharedFramesOptions {
+    std::string data_dir;
+    // The shm_open name of the ring
+    std::string name = "/software_renderer";
+    // Reads the ring of another process instead of rendering into it
+    bool reader = false;
+    // 0 renders, or reads, until the renderer stops
+    size_t frame_count = 600;
+    size_t slot_count = 3;
+    uint16_t width = 800;
+    uint16_t height = 600;
+    // 0 renders as fast as possible
+    uint32_t fps = 60;
+    // Where the reader saves the last frame it read as a BMP, nothing is saved when empty
+    std::string output_dir;
+};
+
+// Renders a turntable of the model headlessly and writes every frame to the output directory on a background thread.
+// Prints the frame rate with and without the writes, and the scale of every frame with a frame budget.
+// Returns the process exit code.
+int run_export(const ExportOptions& options);
+
+// Renders the same turntable as headerless BGRA frames into a pipe for an external encoder, one frame is rendered while
+// the previous one is written. Prints the frame rate and how long the reader held rendering back to stderr.
+int run_stream(const StreamOptions& options);
+
+// Renders the turntable straight into a shared memory ring of framebuffers for other processes on the host, or reads
+// the ring of another process and reports how many frames it got, missed and had to read again.
+int run_shared_frames(const SharedFramesOptions& options);
+}
@@ -0,0 +1,92 @@
+#include "frame_pipeline.h"
+
+namespace renderer {
+FramePipeline::FramePipeline(Renderer& renderer, bool pipelined) : pipelined(pipelined), renderer(renderer) {
+    thread = std::thread(&FramePipeline::run, this);
+}
+
+FramePipeline::~FramePipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    prepare_requested.notify_one();
+    thread.join();
+}
+
+void FramePipeline::flush(RenderTarget& target) {
+    wait_prepared();
+    if (frame_in_flight) {
+        renderer.rasterize(geometries[pending_slot], target);
+        frame_in_flight = false;
+    }
+}
+
+bool FramePipeline::is_pipelined() const {
+    return pipelined;
+}
+
+void FramePipeline::set_pipelined(bool pipelined, RenderTarget& target) {
+    if (!pipelined) {
+        flush(target);
+    }
+    this->pipelined = pipelined;
+}
+
+void FramePipeline::submit(const CommandList& command_list, RenderTarget& target) {
+    if (!pipelined) {
+        renderer.submit(command_list, target);
+        return;
+    }
+
+    // The worker owns the other slot until it is done with the previous frame
+    wait_prepared();
+    const size_t previous_slot = pending_slot;
+    const bool previous_in_flight = frame_in_flight;
+    pending_slot = (pending_slot + 1) % 2;
+    command_lists[pending_slot] = command_list;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_height = target.get_height();
+        pending_width = target.get_width();
+        preparing = true;
+    }
+    prepare_requested.notify_one();
+    frame_in_flight = true;
+
+    if (previous_in_flight) {
+        renderer.rasterize(geometries[previous_slot], target);
+    }
+}
+
+void FramePipeline::run() {
+    while (true) {
+        size_t slot;
+        uint16_t width;
+        uint16_t height;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            prepare_requested.wait(lock, [this]() { return stopping || preparing; });
+            if (stopping) {
+                return;
+            }
+            slot = pending_slot;
+            width = pending_width;
+            height = pending_height;
+        }
+
+        renderer.prepare(command_lists[slot], width, height, geometries[slot]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            preparing = false;
+        }
+        prepare_done.notify_one();
+    }
+}
+
+void FramePipeline::wait_prepared() {
+    std::unique_lock<std::mutex> lock(mutex);
+    prepare_done.wait(lock, [this]() { return !preparing; });
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "command_list.h"
+#include "render_target.h"
+#include "renderer.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace renderer {
+// Overlaps the geometry stage of a frame with the rasterization of the previous one. Pipelined, submit copies the
+// list, starts preparing it on a worker thread and rasterizes the frame submitted before it meanwhile, so the target
+// always shows the previous frame: one frame of latency for the time of the geometry stage. The first submit leaves
+// the target untouched. Not pipelined, submit is a plain Renderer::submit.
+class FramePipeline {
+public:
+    FramePipeline(Renderer& renderer, bool pipelined);
+    ~FramePipeline();
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Waits for the frame in flight and rasterizes it. Anything else that uses the renderer, like a shaded draw,
+    // has to flush first.
+    void flush(RenderTarget& target);
+    bool is_pipelined() const;
+    // Turning pipelining off flushes the frame in flight into target
+    void set_pipelined(bool pipelined, RenderTarget& target);
+    void submit(const CommandList& command_list, RenderTarget& target);
+private:
+    void run();
+    void wait_prepared();
+
+    CommandList command_lists[2];
+    // Set while the frame in pending_slot is prepared or waits to be rasterized
+    bool frame_in_flight = false;
+    FrameGeometry geometries[2] {};
+    std::mutex mutex;
+    // The size of the target the frame in flight is prepared for
+    uint16_t pending_height = 0;
+    size_t pending_slot = 0;
+    uint16_t pending_width = 0;
+    bool pipelined;
+    std::condition_variable prepare_done;
+    std::condition_variable prepare_requested;
+    bool preparing = false;
+    Renderer& renderer;
+    bool stopping = false;
+    std::thread thread;
+};
+}
@@ -0,0 +1,98 @@
+#include "frame_presenter.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace renderer {
+FramePresenter::FramePresenter(size_t buffer_count, uint16_t width, uint16_t height, PresentFunction present)
+        : present(std::move(present)) {
+    targets.resize(std::max<size_t>(buffer_count, 1));
+    free_targets.reserve(targets.size());
+    queued_targets.reserve(targets.size());
+    for (std::unique_ptr<RenderTarget>& target : targets) {
+        target = std::make_unique<RenderTarget>(width, height);
+        free_targets.push_back(target.get());
+    }
+    thread = std::thread(&FramePresenter::run, this);
+}
+
+FramePresenter::~FramePresenter() {
+    finish();
+}
+
+RenderTarget& FramePresenter::acquire(uint16_t width, uint16_t height) {
+    RenderTarget* target;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (free_targets.empty()) {
+            const auto start = std::chrono::steady_clock::now();
+            buffer_freed.wait(lock, [this]() { return !free_targets.empty(); });
+            stats.stalls++;
+            stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        target = free_targets.back();
+        free_targets.pop_back();
+    }
+
+    // A free target belongs to the caller alone, it can be resized outside of the lock
+    if (target->get_width() != width || target->get_height() != height) {
+        target->resize(width, height);
+    }
+    return *target;
+}
+
+void FramePresenter::submit(RenderTarget& target) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued_targets.push_back(&target);
+    }
+    frame_queued.notify_one();
+}
+
+void FramePresenter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frame_queued.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+size_t FramePresenter::get_buffer_count() const {
+    return targets.size();
+}
+
+FramePresenterStats FramePresenter::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void FramePresenter::run() {
+    while (true) {
+        RenderTarget* target;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_queued.wait(lock, [this]() { return stopping || !queued_targets.empty(); });
+            if (queued_targets.empty()) {
+                return;
+            }
+            target = queued_targets.front();
+            queued_targets.erase(queued_targets.begin());
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        present(*target);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.frames_presented++;
+            stats.present_seconds += seconds;
+            free_targets.push_back(target);
+        }
+        buffer_freed.notify_one();
+    }
+}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "render_target.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace renderer {
+struct FramePresenterStats {
+    uint64_t frames_presented;
+    // How many times acquire waited for the present thread because every buffer was in flight
+    uint64_t stalls;
+    double stall_seconds;
+    double present_seconds;
+};
+
+// Hands finished frames to a present thread, which passes them to the present function in order. Rendering goes on
+// into the other buffers meanwhile and only waits when all of them are queued or being presented, so two buffers
+// double buffer and three triple buffer the window.
+class FramePresenter {
+public:
+    using PresentFunction = std::function<void(const RenderTarget& target)>;
+
+    FramePresenter(size_t buffer_count, uint16_t width, uint16_t height, PresentFunction present);
+    ~FramePresenter();
+    FramePresenter(const FramePresenter&) = delete;
+    FramePresenter& operator=(const FramePresenter&) = delete;
+
+    // A free target to render the next frame into, resized if needed. Its contents are undefined.
+    RenderTarget& acquire(uint16_t width, uint16_t height);
+    // Queues the target returned by acquire for presentation
+    void submit(RenderTarget& target);
+    // Presents the queued frames and stops the thread
+    void finish();
+    size_t get_buffer_count() const;
+    FramePresenterStats get_stats() const;
+private:
+    void run();
+
+    std::condition_variable buffer_freed;
+    std::condition_variable frame_queued;
+    std::vector<RenderTarget*> free_targets;
+    mutable std::mutex mutex;
+    PresentFunction present;
+    // A vector rather than a deque, which allocates a block every so many frames, it never holds more than the pool
+    std::vector<RenderTarget*> queued_targets;
+    FramePresenterStats stats {};
+    bool stopping = false;
+    std::vector<std::unique_ptr<RenderTarget>> targets;
+    std::thread thread;
+};
+}
@@ -0,0 +1,233 @@
+#include "frame_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace renderer {
+namespace {
+#if !defined(_WIN32)
+#if defined(IOV_MAX)
+constexpr size_t MAX_IOVECS = IOV_MAX;
+#else
+constexpr size_t MAX_IOVECS = 1024;
+#endif
+#endif
+
+int open_stream(const std::string& path) {
+#if defined(_WIN32)
+    if (path == "-") {
+        const int fd = _dup(1);
+        if (fd >= 0) {
+            _setmode(fd, _O_BINARY);
+            _dup2(2, 1);
+        }
+        return fd;
+    }
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    // A reader closing the pipe fails the write with EPIPE instead of killing the process
+    std::signal(SIGPIPE, SIG_IGN);
+    if (path == "-") {
+        std::cout.flush();
+        const int fd = dup(STDOUT_FILENO);
+        if (fd >= 0) {
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+        return fd;
+    }
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+void close_stream(int fd) {
+#if defined(_WIN32)
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+}
+
+FrameStream::FrameStream(const std::string& path, uint16_t width, uint16_t height) : targets{{width, height}, {width, height}} {
+    fd = open_stream(path);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << (path == "-" ? "stdout" : path) << std::endl;
+        failed = true;
+    }
+    thread = std::thread(&FrameStream::run, this);
+}
+
+FrameStream::~FrameStream() {
+    finish();
+}
+
+RenderTarget& FrameStream::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (busy[next]) {
+        const auto start = std::chrono::steady_clock::now();
+        buffer_freed.wait(lock, [this]() { return !busy[next]; });
+        stats.stalls++;
+        stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return targets[next];
+}
+
+void FrameStream::submit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy[next] = true;
+        queued_frames.push_back(next);
+        next = (next + 1) % 2;
+    }
+    frame_queued.notify_one();
+}
+
+bool FrameStream::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frame_queued.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (fd >= 0) {
+        close_stream(fd);
+        fd = -1;
+    }
+    return !failed;
+}
+
+FrameStreamStats FrameStream::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+bool FrameStream::has_failed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void FrameStream::run() {
+    while (true) {
+        size_t index;
+        bool skip;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_queued.wait(lock, [this]() { return stopping || !queued_frames.empty(); });
+            if (queued_frames.empty()) {
+                return;
+            }
+            index = queued_frames.front();
+            queued_frames.pop_front();
+            skip = failed;
+        }
+
+        // The target is only read here, the producer renders into the other one meanwhile
+        uint64_t bytes = 0;
+        const auto start = std::chrono::steady_clock::now();
+        const bool written = !skip && write_frame(targets[index], bytes);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (written) {
+                stats.frames_written++;
+                stats.bytes_written += bytes;
+            } else {
+                failed = true;
+            }
+            stats.write_seconds += seconds;
+            busy[index] = false;
+        }
+        buffer_freed.notify_one();
+    }
+}
+
+bool FrameStream::write_frame(const RenderTarget& target, uint64_t& bytes) {
+    const size_t row_bytes = target.get_width() * sizeof(uint32_t);
+    uint64_t write_calls = 0;
+    uint64_t partial_writes = 0;
+    bool written = true;
+
+#if defined(_WIN32)
+    for (size_t y = 0; y < target.get_height() && written; y++) {
+        const auto* row = reinterpret_cast<const char*>(target.get_color_row(y));
+        size_t offset = 0;
+        while (offset < row_bytes) {
+            const int result = _write(fd, row + offset, static_cast<unsigned int>(row_bytes - offset));
+            write_calls++;
+            if (result <= 0) {
+                written = false;
+                break;
+            }
+            partial_writes += static_cast<size_t>(result) < row_bytes - offset;
+            offset += result;
+        }
+    }
+#else
+    // One iovec per row, or a single one for the whole frame when the rows aren't padded
+    std::vector<iovec> iovecs;
+    if (target.get_stride() == target.get_width()) {
+        iovecs.push_back({const_cast<uint32_t*>(target.get_color_buffer()), row_bytes * target.get_height()});
+    } else {
+        iovecs.resize(target.get_height());
+        for (size_t y = 0; y < target.get_height(); y++) {
+            iovecs[y] = {const_cast<uint32_t*>(target.get_color_row(y)), row_bytes};
+        }
+    }
+
+    size_t first = 0;
+    while (first < iovecs.size()) {
+        const size_t count = std::min(iovecs.size() - first, MAX_IOVECS);
+        size_t requested = 0;
+        for (size_t i = first; i < first + count; i++) {
+            requested += iovecs[i].iov_len;
+        }
+
+        ssize_t result = writev(fd, iovecs.data() + first, static_cast<int>(count));
+        write_calls++;
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Failed to write a frame: " << std::strerror(errno) << std::endl;
+            written = false;
+            break;
+        }
+        partial_writes += static_cast<size_t>(result) < requested;
+
+        // Skips what was taken and resumes in the middle of the iovec the write stopped in
+        while (first < iovecs.size() && static_cast<size_t>(result) >= iovecs[first].iov_len) {
+            result -= static_cast<ssize_t>(iovecs[first].iov_len);
+            first++;
+        }
+        if (result > 0) {
+            iovecs[first].iov_base = static_cast<uint8_t*>(iovecs[first].iov_base) + result;
+            iovecs[first].iov_len -= result;
+        }
+    }
+#endif
+
+    bytes = written ? row_bytes * target.get_height() : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.write_calls += write_calls;
+    stats.partial_writes += partial_writes;
+    return written;
+}
+}
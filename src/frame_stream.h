@@ -0,0 +1,65 @@
+#pragma once
+
+#include "render_target.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace renderer {
+struct FrameStreamStats {
+    uint64_t bytes_written;
+    uint64_t frames_written;
+    // Write system calls, a frame takes one per IOV_MAX rows unless the reader drains the pipe slower than it fills
+    uint64_t write_calls;
+    // Writes that returned before the whole request was taken, the pipe was full
+    uint64_t partial_writes;
+    // How many times acquire waited for the I/O thread because the reader had not taken the previous frame yet
+    uint64_t stalls;
+    double stall_seconds;
+    double write_seconds;
+};
+
+// Streams headerless BGRA frames to stdout or a file, typically a named pipe read by an encoder. The stream owns two
+// render targets: the caller renders into one while the I/O thread writes the other, straight from its rows with
+// vectored writes, so nothing is copied and the row padding is skipped for free.
+class FrameStream {
+public:
+    // "-" streams to stdout. Everything else the process prints to stdout is redirected to stderr from then on,
+    // so that it doesn't end up in the middle of a frame. Opening a named pipe blocks until it has a reader.
+    FrameStream(const std::string& path, uint16_t width, uint16_t height);
+    ~FrameStream();
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+
+    // The target to render the next frame into, waits while it is still being written
+    RenderTarget& acquire();
+    // Queues the target returned by the last acquire
+    void submit();
+    // Waits for the queued frames and closes the stream, returns false if any of them failed to write
+    bool finish();
+    FrameStreamStats get_stats() const;
+    // The reader went away or a write failed, later frames are dropped
+    bool has_failed() const;
+private:
+    void run();
+    bool write_frame(const RenderTarget& target, uint64_t& bytes);
+
+    bool busy[2] = {false, false};
+    std::condition_variable buffer_freed;
+    bool failed = false;
+    int fd = -1;
+    std::condition_variable frame_queued;
+    mutable std::mutex mutex;
+    size_t next = 0;
+    std::deque<size_t> queued_frames;
+    FrameStreamStats stats {};
+    bool stopping = false;
+    RenderTarget targets[2];
+    std::thread thread;
+};
+}
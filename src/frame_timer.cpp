@@ -0,0 +1,105 @@
+#include "frame_timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace renderer {
+namespace {
+// Hybrid pacing wakes up this long before the deadline, which covers the usual oversleep of a timer
+constexpr double SPIN_SECONDS = 0.002;
+
+// The value below which the given fraction of the sorted times falls, nearest rank
+double get_percentile(const std::vector<double>& sorted_times, double fraction) {
+    const auto rank = static_cast<size_t>(fraction * static_cast<double>(sorted_times.size() - 1) + 0.5);
+    return sorted_times[rank];
+}
+}
+
+bool parse_frame_pacing(const std::string& name, FramePacing& pacing) {
+    if (name == "sleep") {
+        pacing = FramePacing::Sleep;
+    } else if (name == "spin") {
+        pacing = FramePacing::Spin;
+    } else if (name == "hybrid") {
+        pacing = FramePacing::Hybrid;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+FrameTimer::FrameTimer(Counter counter, uint64_t frequency, size_t window)
+        : counter(counter), frequency(frequency), previous_end(counter()), window(std::max<size_t>(window, 1)) {
+    frame_times.reserve(this->window);
+    sorted_times.reserve(this->window);
+}
+
+void FrameTimer::set_frame_cap(double frames_per_second, FramePacing pacing) {
+    frame_period = frames_per_second > 0. ? static_cast<uint64_t>(static_cast<double>(frequency) / frames_per_second) : 0;
+    next_deadline = 0;
+    this->pacing = pacing;
+}
+
+double FrameTimer::end_frame() {
+    if (frame_period > 0) {
+        const uint64_t now = counter();
+        if (next_deadline == 0 || now > next_deadline + frame_period) {
+            next_deadline = now + frame_period;
+        }
+        wait_until(next_deadline);
+        next_deadline += frame_period;
+    }
+
+    const uint64_t end = counter();
+    const double seconds = static_cast<double>(end - previous_end) / static_cast<double>(frequency);
+    previous_end = end;
+
+    // The window is a ring once it is full
+    if (frame_times.size() < window) {
+        frame_times.push_back(seconds);
+    } else {
+        frame_times[next_frame] = seconds;
+    }
+    next_frame = (next_frame + 1) % window;
+    return seconds;
+}
+
+FrameTimeStats FrameTimer::get_stats() const {
+    FrameTimeStats stats {};
+    stats.frame_count = frame_times.size();
+    if (frame_times.empty()) {
+        return stats;
+    }
+
+    sorted_times.assign(frame_times.begin(), frame_times.end());
+    std::sort(sorted_times.begin(), sorted_times.end());
+    double total = 0.;
+    for (double seconds : sorted_times) {
+        total += seconds;
+    }
+    stats.average = total / static_cast<double>(sorted_times.size());
+    stats.p50 = get_percentile(sorted_times, 0.5);
+    stats.p95 = get_percentile(sorted_times, 0.95);
+    stats.p99 = get_percentile(sorted_times, 0.99);
+    stats.max = sorted_times.back();
+    return stats;
+}
+
+void FrameTimer::wait_until(uint64_t deadline) const {
+    if (pacing != FramePacing::Spin) {
+        const uint64_t spin_ticks = pacing == FramePacing::Hybrid ? static_cast<uint64_t>(SPIN_SECONDS * static_cast<double>(frequency)) : 0;
+        const uint64_t now = counter();
+        if (deadline > now + spin_ticks) {
+            const double seconds = static_cast<double>(deadline - now - spin_ticks) / static_cast<double>(frequency);
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        }
+        if (pacing == FramePacing::Sleep) {
+            return;
+        }
+    }
+    while (counter() < deadline) {
+        std::this_thread::yield();
+    }
+}
+}
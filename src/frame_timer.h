@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace renderer {
+// How FrameTimer waits for the next frame when the frame rate is capped. Sleeping is cheap but the OS may oversleep by
+// a millisecond or more, spinning is exact but keeps a core busy. Hybrid sleeps until shortly before the deadline and
+// spins the rest.
+enum class FramePacing : uint8_t {
+    Sleep,
+    Spin,
+    Hybrid
+};
+
+bool parse_frame_pacing(const std::string& name, FramePacing& pacing);
+
+// Frame times over the window of recent frames, in seconds
+struct FrameTimeStats {
+    size_t frame_count;
+    double average;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+// Measures the time between frames with a high resolution counter, keeps the most recent ones for a rolling average and
+// percentiles, and optionally paces the frames to a cap. The deadline of every frame is one period after the previous
+// one, so that oversleeping once doesn't shift the following frames, but a frame that runs late by more than a period
+// starts a new schedule instead of rushing the next ones to catch up.
+class FrameTimer {
+public:
+    using Counter = uint64_t (*)();
+
+    // counter returns ticks at frequency per second, like SDL_GetPerformanceCounter
+    FrameTimer(Counter counter, uint64_t frequency, size_t window = 240);
+    // Caps the frame rate, 0 uncaps it
+    void set_frame_cap(double frames_per_second, FramePacing pacing);
+    // Waits until the cap allows the next frame, then records the time since the previous call and returns it in seconds
+    double end_frame();
+    // Percentiles of the window, computed on every call
+    FrameTimeStats get_stats() const;
+private:
+    void wait_until(uint64_t deadline) const;
+
+    Counter counter;
+    uint64_t frame_period = 0;
+    std::vector<double> frame_times;
+    uint64_t frequency;
+    size_t next_frame = 0;
+    uint64_t next_deadline = 0;
+    FramePacing pacing = FramePacing::Hybrid;
+    uint64_t previous_end;
+    mutable std::vector<double> sorted_times;
+    size_t window;
+};
+}
@@ -0,0 +1,210 @@
+#include "frame_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <ghc/filesystem.hpp>
+
+namespace renderer {
+namespace {
+void put_u16(std::vector<uint8_t>& bytes, uint16_t value) {
+    bytes.push_back(static_cast<uint8_t>(value));
+    bytes.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void put_u32(std::vector<uint8_t>& bytes, uint32_t value) {
+    put_u16(bytes, static_cast<uint16_t>(value));
+    put_u16(bytes, static_cast<uint16_t>(value >> 16));
+}
+
+void encode_ppm(const uint32_t* frame, uint16_t width, uint16_t height, std::vector<uint8_t>& bytes) {
+    const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    bytes.assign(header.begin(), header.end());
+    const size_t offset = bytes.size();
+    bytes.resize(offset + static_cast<size_t>(width) * height * 3);
+    uint8_t* rgb = bytes.data() + offset;
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+        rgb[i * 3] = static_cast<uint8_t>(frame[i] >> 16);
+        rgb[i * 3 + 1] = static_cast<uint8_t>(frame[i] >> 8);
+        rgb[i * 3 + 2] = static_cast<uint8_t>(frame[i]);
+    }
+}
+
+// A BITMAPINFOHEADER with a negative height, which stores the rows top-down like the frame
+void encode_bmp_header(uint16_t width, uint16_t height, std::vector<uint8_t>& bytes) {
+    constexpr uint32_t header_size = 14 + 40;
+    const uint32_t image_size = static_cast<uint32_t>(width) * height * 4;
+    bytes.clear();
+    bytes.push_back('B');
+    bytes.push_back('M');
+    put_u32(bytes, header_size + image_size);
+    put_u32(bytes, 0);
+    put_u32(bytes, header_size);
+    put_u32(bytes, 40);
+    put_u32(bytes, width);
+    put_u32(bytes, static_cast<uint32_t>(-static_cast<int32_t>(height)));
+    put_u16(bytes, 1);
+    put_u16(bytes, 32);
+    put_u32(bytes, 0);
+    put_u32(bytes, image_size);
+    put_u32(bytes, 2835);
+    put_u32(bytes, 2835);
+    put_u32(bytes, 0);
+    put_u32(bytes, 0);
+}
+}
+
+bool parse_image_format(const std::string& name, ImageFormat& format) {
+    if (name == "ppm") {
+        format = ImageFormat::Ppm;
+    } else if (name == "bmp") {
+        format = ImageFormat::Bmp;
+    } else if (name == "raw") {
+        format = ImageFormat::Raw;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* get_image_format_extension(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::Ppm:
+            return "ppm";
+        case ImageFormat::Bmp:
+            return "bmp";
+        case ImageFormat::Raw:
+            return "bgra";
+    }
+    return "";
+}
+
+FrameWriter::FrameWriter(const std::string& output_dir, ImageFormat format, uint16_t width, uint16_t height, size_t queue_depth)
+        : output_dir(output_dir), format(format), width(width), height(height) {
+    buffers.resize(std::max<size_t>(queue_depth, 1));
+    for (std::vector<uint32_t>& buffer : buffers) {
+        buffer.resize(static_cast<size_t>(width) * height);
+        free_buffers.push_back(buffer.data());
+    }
+
+    if (format == ImageFormat::Raw) {
+        const ghc::filesystem::path path = ghc::filesystem::path(output_dir) / "frames.bgra";
+        raw_file.open(path.string(), std::ios::binary | std::ios::trunc);
+        if (!raw_file) {
+            std::cerr << "Failed to open " << path.string() << std::endl;
+            failed = true;
+        }
+    }
+    thread = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter() {
+    finish();
+}
+
+uint32_t* FrameWriter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (free_buffers.empty()) {
+        const auto start = std::chrono::steady_clock::now();
+        buffer_freed.wait(lock, [this]() { return !free_buffers.empty(); });
+        stats.stalls++;
+        stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    uint32_t* frame = free_buffers.back();
+    free_buffers.pop_back();
+    return frame;
+}
+
+void FrameWriter::submit(uint32_t* frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued_frames.push_back(frame);
+    }
+    frame_queued.notify_one();
+}
+
+bool FrameWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frame_queued.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (raw_file.is_open()) {
+        raw_file.close();
+        failed = failed || raw_file.fail();
+    }
+    return !failed;
+}
+
+FrameWriterStats FrameWriter::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void FrameWriter::run() {
+    uint64_t frame_number = 0;
+    while (true) {
+        uint32_t* frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_queued.wait(lock, [this]() { return stopping || !queued_frames.empty(); });
+            if (queued_frames.empty()) {
+                return;
+            }
+            frame = queued_frames.front();
+            queued_frames.pop_front();
+        }
+
+        // Encoding and writing happen outside of the lock, the producer can keep acquiring the other buffers
+        uint64_t bytes = 0;
+        const bool written = !failed && write_frame(frame, frame_number++, bytes);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (written) {
+                stats.frames_written++;
+                stats.bytes_written += bytes;
+            } else {
+                failed = true;
+            }
+            free_buffers.push_back(frame);
+        }
+        buffer_freed.notify_one();
+    }
+}
+
+bool FrameWriter::write_frame(const uint32_t* frame, uint64_t frame_number, uint64_t& bytes) {
+    const size_t frame_bytes = static_cast<size_t>(width) * height * sizeof(uint32_t);
+    if (format == ImageFormat::Raw) {
+        raw_file.write(reinterpret_cast<const char*>(frame), static_cast<std::streamsize>(frame_bytes));
+        bytes = frame_bytes;
+        return raw_file.good();
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%05llu.%s", static_cast<unsigned long long>(frame_number), get_image_format_extension(format));
+    const ghc::filesystem::path path = ghc::filesystem::path(output_dir) / name;
+    std::ofstream file(path.string(), std::ios::binary | std::ios::trunc);
+
+    if (format == ImageFormat::Ppm) {
+        encode_ppm(frame, width, height, scratch);
+        file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+        bytes = scratch.size();
+    } else {
+        encode_bmp_header(width, height, scratch);
+        file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+        file.write(reinterpret_cast<const char*>(frame), static_cast<std::streamsize>(frame_bytes));
+        bytes = scratch.size() + frame_bytes;
+    }
+
+    if (!file.good()) {
+        std::cerr << "Failed to write " << path.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace renderer {
+enum class ImageFormat : uint8_t {
+    // Binary RGB, one file per frame
+    Ppm,
+    // 32-bit BGRA, top-down, one file per frame
+    Bmp,
+    // Headerless BGRA frames appended to a single frames.bgra
+    Raw
+};
+
+bool parse_image_format(const std::string& name, ImageFormat& format);
+const char* get_image_format_extension(ImageFormat format);
+
+struct FrameWriterStats {
+    uint64_t bytes_written;
+    uint64_t frames_written;
+    // How many times acquire waited for the I/O thread because every buffer was queued
+    uint64_t stalls;
+    double stall_seconds;
+};
+
+// Encodes and writes frames on a background thread. Frames are handed over in a fixed pool of buffers, so memory stays
+// bounded and the producer only waits when the disk falls behind by more than the whole pool.
+class FrameWriter {
+public:
+    FrameWriter(const std::string& output_dir, ImageFormat format, uint16_t width, uint16_t height, size_t queue_depth);
+    ~FrameWriter();
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // A free buffer of width * height BGRA pixels without row padding, to be filled and passed to submit
+    uint32_t* acquire();
+    void submit(uint32_t* frame);
+    // Waits for the queued frames and stops the thread, returns false if any of them failed to write
+    bool finish();
+    FrameWriterStats get_stats() const;
+private:
+    void run();
+    bool write_frame(const uint32_t* frame, uint64_t frame_number, uint64_t& bytes);
+
+    std::vector<std::vector<uint32_t>> buffers;
+    std::condition_variable buffer_freed;
+    std::vector<uint32_t*> free_buffers;
+    bool failed = false;
+    ImageFormat format;
+    std::condition_variable frame_queued;
+    uint16_t height;
+    mutable std::mutex mutex;
+    std::string output_dir;
+    std::deque<uint32_t*> queued_frames;
+    std::ofstream raw_file;
+    std::vector<uint8_t> scratch;
+    FrameWriterStats stats {};
+    bool stopping = false;
+    std::thread thread;
+    uint16_t width;
+};
+}
@@ -0,0 +1,121 @@
+#include "frustum.h"
+
+namespace renderer {
+uint8_t get_clip_code(const math::Vector<4>& clip) {
+    const float x = clip.data[0];
+    const float y = clip.data[1];
+    const float z = clip.data[2];
+    const float w = clip.data[3];
+
+    uint8_t code = 0;
+    if (x < -w) {
+        code |= CLIP_LEFT;
+    }
+    if (x > w) {
+        code |= CLIP_RIGHT;
+    }
+    if (y < -w) {
+        code |= CLIP_BOTTOM;
+    }
+    if (y > w) {
+        code |= CLIP_TOP;
+    }
+    if (z < -w) {
+        code |= CLIP_NEAR;
+    }
+    if (z > w) {
+        code |= CLIP_FAR;
+    }
+    return code;
+}
+
+bool get_eye_position(const math::Matrix<4, 4>& mtx, float eye[3]) {
+    const float* row0 = &mtx.data[0];
+    const float* row1 = &mtx.data[4];
+    const float* row3 = &mtx.data[12];
+
+    const float det = row0[0] * (row1[1] * row3[2] - row1[2] * row3[1])
+            - row0[1] * (row1[0] * row3[2] - row1[2] * row3[0])
+            + row0[2] * (row1[0] * row3[1] - row1[1] * row3[0]);
+    if (fabsf(det) < 1e-12f) {
+        return false;
+    }
+
+    const float b0 = -row0[3];
+    const float b1 = -row1[3];
+    const float b3 = -row3[3];
+    eye[0] = (b0 * (row1[1] * row3[2] - row1[2] * row3[1])
+            - row0[1] * (b1 * row3[2] - row1[2] * b3)
+            + row0[2] * (b1 * row3[1] - row1[1] * b3)) / det;
+    eye[1] = (row0[0] * (b1 * row3[2] - row1[2] * b3)
+            - b0 * (row1[0] * row3[2] - row1[2] * row3[0])
+            + row0[2] * (row1[0] * b3 - b1 * row3[0])) / det;
+    eye[2] = (row0[0] * (row1[1] * b3 - b1 * row3[1])
+            - row0[1] * (row1[0] * b3 - b1 * row3[0])
+            + b0 * (row1[0] * row3[1] - row1[1] * row3[0])) / det;
+    return true;
+}
+
+Frustum::Frustum(const math::Matrix<4, 4>& mtx) {
+    const float* row0 = &mtx.data[0];
+    const float* row1 = &mtx.data[4];
+    const float* row2 = &mtx.data[8];
+    const float* row3 = &mtx.data[12];
+
+    for (size_t i = 0; i < 6; i++) {
+        const float* row = i < 2 ? row0 : (i < 4 ? row1 : row2);
+        const float sign = i % 2 == 0 ? 1.f : -1.f;
+
+        Plane plane = {
+                row3[0] + sign * row[0],
+                row3[1] + sign * row[1],
+                row3[2] + sign * row[2],
+                row3[3] + sign * row[3]
+        };
+
+        const float length = sqrtf(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+        if (length > 0.f) {
+            plane.a /= length;
+            plane.b /= length;
+            plane.c /= length;
+            plane.d /= length;
+        }
+        planes[i] = plane;
+    }
+}
+
+Visibility Frustum::classify(const BoundingBox& box) const {
+    Visibility visibility = Visibility::Inside;
+    for (const Plane& plane : planes) {
+        // The corner furthest along the plane normal decides if the box is outside, the nearest one if it is inside
+        const float px = plane.a >= 0.f ? box.max[0] : box.min[0];
+        const float py = plane.b >= 0.f ? box.max[1] : box.min[1];
+        const float pz = plane.c >= 0.f ? box.max[2] : box.min[2];
+        if (plane.a * px + plane.b * py + plane.c * pz + plane.d < 0.f) {
+            return Visibility::Outside;
+        }
+
+        const float nx = plane.a >= 0.f ? box.min[0] : box.max[0];
+        const float ny = plane.b >= 0.f ? box.min[1] : box.max[1];
+        const float nz = plane.c >= 0.f ? box.min[2] : box.max[2];
+        if (plane.a * nx + plane.b * ny + plane.c * nz + plane.d < 0.f) {
+            visibility = Visibility::Intersecting;
+        }
+    }
+    return visibility;
+}
+
+Visibility Frustum::classify(const BoundingSphere& sphere) const {
+    Visibility visibility = Visibility::Inside;
+    for (const Plane& plane : planes) {
+        const float distance = plane.a * sphere.x + plane.b * sphere.y + plane.c * sphere.z + plane.d;
+        if (distance < -sphere.radius) {
+            return Visibility::Outside;
+        }
+        if (distance < sphere.radius) {
+            visibility = Visibility::Intersecting;
+        }
+    }
+    return visibility;
+}
+}
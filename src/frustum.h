@@ -0,0 +1,55 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <cstdint>
+
+namespace renderer {
+struct BoundingBox {
+    float min[3];
+    float max[3];
+};
+
+struct BoundingSphere {
+    float x;
+    float y;
+    float z;
+    float radius;
+};
+
+struct Plane {
+    float a;
+    float b;
+    float c;
+    float d;
+};
+
+enum class Visibility {
+    Outside,
+    Intersecting,
+    Inside
+};
+
+enum ClipCode : uint8_t {
+    CLIP_LEFT = 1 << 0,
+    CLIP_RIGHT = 1 << 1,
+    CLIP_BOTTOM = 1 << 2,
+    CLIP_TOP = 1 << 3,
+    CLIP_NEAR = 1 << 4,
+    CLIP_FAR = 1 << 5
+};
+
+uint8_t get_clip_code(const math::Vector<4>& clip);
+// The eye is the point that a perspective matrix projects to x = y = w = 0
+bool get_eye_position(const math::Matrix<4, 4>& mtx, float eye[3]);
+
+class Frustum {
+public:
+    // Planes are extracted in the space the matrix transforms from, so bounds can be tested without transforming them
+    explicit Frustum(const math::Matrix<4, 4>& mtx);
+    Visibility classify(const BoundingBox& box) const;
+    Visibility classify(const BoundingSphere& sphere) const;
+private:
+    Plane planes[6];
+};
+}
@@ -0,0 +1,319 @@
+#include "golden.h"
+#include "color.h"
+#include "matrix.h"
+#include "model.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <ghc/filesystem.hpp>
+#include <SDL2/SDL.h>
+
+namespace renderer {
+namespace {
+constexpr uint16_t GOLDEN_WIDTH = 160;
+constexpr uint16_t GOLDEN_HEIGHT = 120;
+constexpr float GOLDEN_FOV = 60.f;
+constexpr float GOLDEN_DEPTH = 10.f;
+constexpr Color GOLDEN_CLEAR_COLOR {255, 255, 255, 255};
+
+using SurfacePtr = std::unique_ptr<SDL_Surface, void (*) (SDL_Surface*)>;
+
+struct GoldenScene {
+    std::string name;
+    const Model* model;
+    math::Matrix<4, 4> rotation_mtx;
+    math::Matrix<4, 4> translation_mtx;
+    PipelineState pipeline_state = PipelineState {};
+    Color clear_color = GOLDEN_CLEAR_COLOR;
+};
+
+SurfacePtr make_surface(SDL_Surface* surface) {
+    return SurfacePtr(surface, [](SDL_Surface* s) { SDL_FreeSurface(s); });
+}
+
+// A texture whose texels all differ, so that any change of the interpolated UVs shows up in the image.
+// Alpha only matters to the blended scenes.
+SDL_Surface* create_gradient_texture() {
+    constexpr int size = 16;
+    SDL_Surface* texture = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_BGRA32);
+    if (texture == nullptr) {
+        throw std::runtime_error("Failed to create a texture: " + std::string(SDL_GetError()));
+    }
+
+    auto pixels = static_cast<uint8_t*>(texture->pixels);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            uint8_t* texel = pixels + y * texture->pitch + x * 4;
+            texel[0] = ((x / 4 + y / 4) % 2) * 255;
+            texel[1] = static_cast<uint8_t>(y * 16);
+            texel[2] = static_cast<uint8_t>(x * 16);
+            texel[3] = static_cast<uint8_t>(64 + (x + y) * 6);
+        }
+    }
+    return texture;
+}
+
+// Places a vertex in view space so that it lands on the given normalized device coordinates
+Vertex make_vertex(float ndc_x, float ndc_y, float depth, float u, float v) {
+    const float tan_half_fov = tanf((GOLDEN_FOV * math::PI / 180.f) / 2.f);
+    const float aspect = static_cast<float>(GOLDEN_WIDTH) / GOLDEN_HEIGHT;
+    return Vertex {ndc_x * depth * tan_half_fov * aspect, ndc_y * depth * tan_half_fov, depth, 1.f, u, v};
+}
+
+class TriangleSoup {
+public:
+    void add(float x1, float y1, float x2, float y2, float x3, float y3, float depth = GOLDEN_DEPTH) {
+        add(make_vertex(x1, y1, depth, 0.05f, 0.05f), make_vertex(x2, y2, depth, 0.95f, 0.05f), make_vertex(x3, y3, depth, 0.5f, 0.95f));
+    }
+
+    void add(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3) {
+        const uint32_t first = static_cast<uint32_t>(vertex_buffer.size());
+        vertex_buffer.insert(vertex_buffer.end(), {vertex1, vertex2, vertex3});
+        index_buffer.insert(index_buffer.end(), {first, first + 1, first + 2});
+    }
+
+    std::unique_ptr<Model> build() {
+        return std::make_unique<Model>(std::move(vertex_buffer), std::move(index_buffer), create_gradient_texture());
+    }
+private:
+    std::vector<uint32_t> index_buffer;
+    std::vector<Vertex> vertex_buffer;
+};
+
+std::unique_ptr<Model> create_degenerate_model() {
+    TriangleSoup soup;
+    // A regular triangle, so that an empty image can't pass by accident
+    soup.add(-0.9f, -0.9f, -0.1f, -0.9f, -0.5f, -0.1f);
+    // Collinear vertices
+    soup.add(0.1f, -0.5f, 0.5f, 0.f, 0.9f, 0.5f);
+    soup.add(-0.9f, 0.5f, -0.1f, 0.5f, -0.5f, 0.5f);
+    soup.add(-0.2f, -0.9f, -0.2f, 0.9f, -0.2f, 0.1f);
+    // Repeated vertices
+    soup.add(0.1f, 0.5f, 0.1f, 0.5f, 0.9f, 0.9f);
+    soup.add(0.5f, -0.8f, 0.5f, -0.8f, 0.5f, -0.8f);
+    return soup.build();
+}
+
+std::unique_ptr<Model> create_screen_edges_model() {
+    TriangleSoup soup;
+    // Exactly on the screen corners
+    soup.add(-1.f, -1.f, 0.f, -1.f, -1.f, 0.f);
+    soup.add(1.f, 1.f, 0.f, 1.f, 1.f, 0.f);
+    // Crossing a single edge
+    soup.add(0.6f, -0.6f, 1.4f, -0.2f, 0.6f, 0.2f);
+    soup.add(-0.3f, 0.8f, 0.3f, 0.8f, 0.f, 1.5f);
+    soup.add(-0.3f, -0.8f, 0.3f, -0.8f, 0.f, -1.6f);
+    // Larger than the screen, behind the others
+    soup.add(-3.f, -1.2f, 3.f, -1.2f, 0.f, 3.f, 2.f * GOLDEN_DEPTH);
+    return soup.build();
+}
+
+std::unique_ptr<Model> create_slivers_model() {
+    TriangleSoup soup;
+    // Two triangles sharing a diagonal, any gap or double coverage on the shared edge shows through
+    soup.add(-0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 1.5f * GOLDEN_DEPTH);
+    soup.add(-0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 1.5f * GOLDEN_DEPTH);
+    // A fan of needles at every angle
+    constexpr int needles = 24;
+    for (int i = 0; i < needles; i++) {
+        const float angle = 2.f * math::PI * i / needles;
+        soup.add(0.f, 0.f,
+                 0.9f * cosf(angle), 0.9f * sinf(angle),
+                 0.9f * cosf(angle + 0.02f), 0.9f * sinf(angle + 0.02f));
+    }
+    // Nearly horizontal and nearly vertical slivers
+    soup.add(-0.9f, 0.95f, 0.9f, 0.955f, 0.9f, 0.95f);
+    soup.add(-0.95f, -0.9f, -0.945f, 0.9f, -0.95f, 0.9f);
+    return soup.build();
+}
+
+// A floor receding from the bottom of the screen with the texture repeated along it, affine interpolation bends the checkers
+std::unique_ptr<Model> create_perspective_model() {
+    TriangleSoup soup;
+    const Vertex near_left = make_vertex(-1.f, -1.f, 0.5f * GOLDEN_DEPTH, 0.f, 0.f);
+    const Vertex near_right = make_vertex(1.f, -1.f, 0.5f * GOLDEN_DEPTH, 2.f, 0.f);
+    const Vertex far_left = make_vertex(-0.25f, 0.8f, 4.f * GOLDEN_DEPTH, 0.f, 4.f);
+    const Vertex far_right = make_vertex(0.25f, 0.8f, 4.f * GOLDEN_DEPTH, 2.f, 4.f);
+    soup.add(near_left, near_right, far_right);
+    soup.add(near_left, far_right, far_left);
+    return soup.build();
+}
+
+// Overlapping triangles at different depths with coordinates outside of [0, 1], drawn without depth writes
+std::unique_ptr<Model> create_blending_model() {
+    TriangleSoup soup;
+    soup.add(make_vertex(-0.9f, -0.8f, GOLDEN_DEPTH, -0.5f, -0.5f), make_vertex(0.5f, -0.8f, GOLDEN_DEPTH, 1.5f, -0.5f), make_vertex(-0.2f, 0.8f, GOLDEN_DEPTH, 0.5f, 1.5f));
+    soup.add(make_vertex(-0.5f, 0.8f, 1.2f * GOLDEN_DEPTH, -0.5f, 1.5f), make_vertex(0.9f, 0.8f, 1.2f * GOLDEN_DEPTH, 1.5f, 1.5f), make_vertex(0.2f, -0.8f, 1.2f * GOLDEN_DEPTH, 0.5f, -0.5f));
+    soup.add(make_vertex(-0.9f, -0.1f, 0.8f * GOLDEN_DEPTH, 0.f, 0.f), make_vertex(0.9f, -0.1f, 0.8f * GOLDEN_DEPTH, 1.f, 0.f), make_vertex(0.f, 0.3f, 0.8f * GOLDEN_DEPTH, 0.5f, 1.f));
+    return soup.build();
+}
+
+std::vector<uint32_t> render_scene(const GoldenScene& scene) {
+    Renderer renderer(scene.clear_color);
+    RenderTarget target(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    renderer.set_pipeline_state(scene.pipeline_state);
+    renderer.clear_buffer(target);
+    renderer.draw_model(scene.model, target, scene.rotation_mtx, scene.translation_mtx, GOLDEN_FOV);
+
+    std::vector<uint32_t> buffer(GOLDEN_WIDTH * GOLDEN_HEIGHT);
+    target.copy_to(buffer.data(), GOLDEN_WIDTH * sizeof(uint32_t));
+    return buffer;
+}
+
+bool save_image(const std::vector<uint32_t>& buffer, const ghc::filesystem::path& path) {
+    SurfacePtr surface = make_surface(SDL_CreateRGBSurfaceFrom(const_cast<uint32_t*>(buffer.data()),
+            GOLDEN_WIDTH, GOLDEN_HEIGHT, 32, GOLDEN_WIDTH * 4, 0x00ff0000, 0x0000ff00, 0x000000ff, 0));
+    if (surface == nullptr || SDL_SaveBMP(surface.get(), path.string().c_str()) != 0) {
+        std::cerr << "Failed to write " << path.string() << ": " << SDL_GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool load_image(const ghc::filesystem::path& path, std::vector<uint32_t>& buffer) {
+    SurfacePtr bitmap = make_surface(SDL_LoadBMP(path.string().c_str()));
+    if (bitmap == nullptr) {
+        return false;
+    }
+    SurfacePtr surface = make_surface(SDL_ConvertSurfaceFormat(bitmap.get(), SDL_PIXELFORMAT_RGB888, 0));
+    if (surface == nullptr || surface->w != GOLDEN_WIDTH || surface->h != GOLDEN_HEIGHT) {
+        return false;
+    }
+
+    buffer.resize(GOLDEN_WIDTH * GOLDEN_HEIGHT);
+    for (int y = 0; y < surface->h; y++) {
+        const auto row = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(surface->pixels) + y * surface->pitch);
+        std::copy(row, row + surface->w, buffer.begin() + y * GOLDEN_WIDTH);
+    }
+    return true;
+}
+
+uint8_t get_channel_difference(uint32_t l, uint32_t r) {
+    uint8_t difference = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        const int channel_l = (l >> shift) & 0xff;
+        const int channel_r = (r >> shift) & 0xff;
+        difference = std::max(difference, static_cast<uint8_t>(std::abs(channel_l - channel_r)));
+    }
+    return difference;
+}
+
+// Mismatching pixels are red, matching ones are a faded copy of the reference
+size_t compare_images(const std::vector<uint32_t>& expected, const std::vector<uint32_t>& actual, uint8_t tolerance, std::vector<uint32_t>& diff) {
+    size_t mismatches = 0;
+    diff.resize(expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (get_channel_difference(expected[i], actual[i]) > tolerance) {
+            mismatches++;
+            diff[i] = 0x00ff0000;
+        } else {
+            const uint32_t luma = (((expected[i] >> 16) & 0xff) + ((expected[i] >> 8) & 0xff) + (expected[i] & 0xff)) / 3 / 4 + 191;
+            diff[i] = luma << 16 | luma << 8 | luma;
+        }
+    }
+    return mismatches;
+}
+}
+
+int run_golden(const GoldenOptions& options) {
+    std::vector<std::unique_ptr<Model>> models;
+    std::vector<GoldenScene> scenes;
+    const math::Matrix<4, 4> identity_mtx = math::create_translation_matrix(0.f, 0.f, 0.f);
+
+    try {
+        ghc::filesystem::path model_path = ghc::filesystem::path(options.data_dir) / "Pallas_Cat";
+        models.push_back(std::make_unique<Model>(model_path.string()));
+        const math::Matrix<4, 4> tilt_mtx = math::create_rotation_matrix(1.f, 0.f, 0.f, 1.6f);
+        const math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
+        const float angles[] = {0.f, 2.1f, 4.2f};
+        for (size_t i = 0; i < std::size(angles); i++) {
+            const math::Matrix<4, 4> rotation_mtx = math::mul(tilt_mtx, math::create_rotation_matrix(0.f, 0.f, 1.f, angles[i]));
+            scenes.push_back(GoldenScene {"pallas_cat_" + std::to_string(i), models.back().get(), rotation_mtx, translation_mtx});
+        }
+
+        models.push_back(create_degenerate_model());
+        scenes.push_back(GoldenScene {"degenerate", models.back().get(), identity_mtx, identity_mtx});
+        models.push_back(create_screen_edges_model());
+        scenes.push_back(GoldenScene {"screen_edges", models.back().get(), identity_mtx, identity_mtx});
+        models.push_back(create_slivers_model());
+        scenes.push_back(GoldenScene {"slivers", models.back().get(), identity_mtx, identity_mtx});
+
+        models.push_back(create_perspective_model());
+        const Model* perspective_model = models.back().get();
+        scenes.push_back(GoldenScene {"perspective_affine", perspective_model, identity_mtx, identity_mtx});
+        PipelineState perspective_state;
+        perspective_state.interpolation = Interpolation::Perspective;
+        scenes.push_back(GoldenScene {"perspective_correct", perspective_model, identity_mtx, identity_mtx, perspective_state});
+
+        models.push_back(create_blending_model());
+        const Model* blending_model = models.back().get();
+        PipelineState alpha_state;
+        alpha_state.depth_mode = DepthMode::Test;
+        alpha_state.blend_mode = BlendMode::Alpha;
+        scenes.push_back(GoldenScene {"blend_alpha", blending_model, identity_mtx, identity_mtx, alpha_state});
+        PipelineState additive_state;
+        additive_state.depth_mode = DepthMode::Off;
+        additive_state.texture_wrap = TextureWrap::Clamp;
+        additive_state.blend_mode = BlendMode::Additive;
+        scenes.push_back(GoldenScene {"blend_additive_clamp", blending_model, identity_mtx, identity_mtx, additive_state, Color {32, 32, 32, 255}});
+    } catch (const std::runtime_error& error) {
+        std::cout << "Runtime Error: " << error.what() << std::endl;
+        return 1;
+    }
+
+    const ghc::filesystem::path golden_dir(options.golden_dir);
+    std::error_code error_code;
+    ghc::filesystem::create_directories(golden_dir, error_code);
+
+    size_t failures = 0;
+    for (const GoldenScene& scene : scenes) {
+        const std::vector<uint32_t> actual = render_scene(scene);
+        const ghc::filesystem::path reference_path = golden_dir / (scene.name + ".bmp");
+
+        if (options.update) {
+            if (save_image(actual, reference_path)) {
+                std::cout << "UPDATED  " << scene.name << std::endl;
+            } else {
+                failures++;
+            }
+            continue;
+        }
+
+        std::vector<uint32_t> expected;
+        if (!load_image(reference_path, expected)) {
+            std::cout << "MISSING  " << scene.name << ": no " << GOLDEN_WIDTH << "x" << GOLDEN_HEIGHT << " reference at "
+                      << reference_path.string() << ", run with --update on a known good build" << std::endl;
+            failures++;
+            continue;
+        }
+
+        std::vector<uint32_t> diff;
+        const size_t mismatches = compare_images(expected, actual, options.tolerance, diff);
+        if (mismatches == 0) {
+            std::cout << "PASSED   " << scene.name << std::endl;
+            continue;
+        }
+
+        failures++;
+        save_image(actual, golden_dir / (scene.name + ".actual.bmp"));
+        save_image(diff, golden_dir / (scene.name + ".diff.bmp"));
+        std::cout << "FAILED   " << scene.name << ": " << mismatches << " pixels differ by more than "
+                  << static_cast<int>(options.tolerance) << std::endl;
+    }
+
+    if (options.update) {
+        std::cout << scenes.size() - failures << " of " << scenes.size() << " golden images updated" << std::endl;
+    } else {
+        std::cout << scenes.size() - failures << " of " << scenes.size() << " golden images match" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
+}
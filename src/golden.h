@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace renderer {
+struct GoldenOptions {
+    std::string data_dir;
+    std::string golden_dir;
+    // The largest per-channel difference a pixel may have before it counts as a mismatch
+    uint8_t tolerance = 0;
+    bool update = false;
+};
+
+// Renders the canonical scenes headlessly and compares them to the reference images in the golden directory,
+// writing <scene>.actual.bmp and <scene>.diff.bmp next to them on a mismatch. Returns the process exit code.
+int run_golden(const GoldenOptions& options);
+}
@@ -0,0 +1,108 @@
+#include "kernels.h"
+#include "frustum.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace renderer {
+namespace {
+void clear_scalar(uint32_t* buffer, float* zbuffer, size_t count, uint32_t color, float depth) {
+    std::fill(buffer, buffer + count, color);
+    std::fill(zbuffer, zbuffer + count, depth);
+}
+
+void draw_span_scalar(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, float* zbuffer_row, SpanFragments& fragments) {
+    const float py = static_cast<float>(y);
+    fragments.count = 0;
+    for (int64_t x = x1; x <= x2; x++) {
+        draw_span_pixel(triangle, x, py, zbuffer_row, fragments);
+    }
+}
+
+void sample_scalar(const Texture& texture, const SpanFragments& fragments, uint32_t* buffer_row) {
+    for (uint32_t i = 0; i < fragments.count; i++) {
+        buffer_row[fragments.x[i]] = sample_texel(texture, fragments.u[i], fragments.v[i]);
+    }
+}
+
+void transform_scalar(const math::Matrix<4, 4>& mtx, const Vertex* vertices, const uint32_t* indices, size_t count, TransformedVertex* transformed) {
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t index = indices[i];
+        const Vertex& vertex = vertices[index];
+        const math::Vector<4> vector = math::mul(mtx, vertex.xyzw);
+        TransformedVertex& out = transformed[index];
+        out.clip_code = get_clip_code(vector);
+        if ((out.clip_code & CLIP_NEAR) == 0) {
+            out.vertex = project_vertex(vertex, vector);
+        }
+    }
+}
+
+void log_kernel(const char* kernel, const KernelVariant& variant) {
+    std::cout << " " << kernel << "=" << variant.name;
+}
+
+Kernels select_kernels() {
+    const CpuLevel detected = get_cpu_level();
+    CpuLevel level = detected;
+
+    std::cout << "CPU level " << get_cpu_level_name(detected);
+    const char* forced = std::getenv("SOFTWARE_RENDERER_CPU");
+    if (forced != nullptr && forced[0] != '\0') {
+        CpuLevel forced_level;
+        if (!parse_cpu_level(forced, forced_level)) {
+            std::cout << ", ignoring unknown SOFTWARE_RENDERER_CPU=" << forced;
+        } else if (forced_level > detected) {
+            std::cout << ", ignoring unsupported SOFTWARE_RENDERER_CPU=" << forced;
+        } else {
+            level = forced_level;
+            std::cout << ", forced to " << get_cpu_level_name(level) << " by SOFTWARE_RENDERER_CPU";
+        }
+    }
+
+    const Kernels kernels = get_kernels(level);
+    std::cout << ", kernels:";
+    log_kernel("clear", kernels.clear_variant);
+    log_kernel("draw_span", kernels.draw_span_variant);
+    log_kernel("sample", kernels.sample_variant);
+    log_kernel("transform", kernels.transform_variant);
+    std::cout << std::endl;
+    return kernels;
+}
+}
+
+const Kernels& get_kernels() {
+    static const Kernels kernels = select_kernels();
+    return kernels;
+}
+
+Kernels get_kernels(CpuLevel level) {
+    Kernels kernels {};
+    set_scalar_kernels(kernels);
+#if defined(KERNELS_X86)
+    if (level >= CpuLevel::SSE42) {
+        set_sse42_kernels(kernels);
+    }
+    if (level >= CpuLevel::AVX2) {
+        set_avx2_kernels(kernels);
+    }
+    if (level >= CpuLevel::AVX512) {
+        set_avx512_kernels(kernels);
+    }
+#endif
+    return kernels;
+}
+
+void set_scalar_kernels(Kernels& kernels) {
+    const KernelVariant variant = {CpuLevel::Scalar, "scalar"};
+    kernels.clear = clear_scalar;
+    kernels.clear_variant = variant;
+    kernels.draw_span = draw_span_scalar;
+    kernels.draw_span_variant = variant;
+    kernels.sample = sample_scalar;
+    kernels.sample_variant = variant;
+    kernels.transform = transform_scalar;
+    kernels.transform_variant = variant;
+}
+}
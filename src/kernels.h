@@ -0,0 +1,152 @@
+#pragma once
+
+#include "cpu.h"
+#include "matrix.h"
+#include "vertex.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Kernels for a higher instruction set than the build targets are compiled per function, so that one binary runs everywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KERNELS_X86
+#endif
+
+namespace renderer {
+constexpr size_t SPAN_CAPACITY = 256;
+
+// A 32-bit BGRA texture without row padding
+struct Texture {
+    const uint32_t* texels;
+    uint32_t width;
+    uint32_t height;
+};
+
+// The sorted vertices of a triangle in pixel coordinates, with the attributes the span kernels interpolate
+struct ScreenTriangle {
+    float x[3];
+    float y[3];
+    float z[3];
+    float u[3];
+    float v[3];
+    // 1 / w of the vertices, only read by the perspective correct interpolation
+    float inv_w[3];
+    float barycentric_denom;
+};
+
+// The pixels of a span that passed the depth test, in increasing x
+struct SpanFragments {
+    uint32_t count;
+    uint32_t x[SPAN_CAPACITY];
+    float u[SPAN_CAPACITY];
+    float v[SPAN_CAPACITY];
+};
+
+// Fills both buffers of count pixels
+using ClearKernel = void (*)(uint32_t* buffer, float* zbuffer, size_t count, uint32_t color, float depth);
+// Depth tests the pixels x1 to x2 of row y, at most SPAN_CAPACITY of them, writing the depth and collecting the fragments that pass
+using SpanKernel = void (*)(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, float* zbuffer_row, SpanFragments& fragments);
+// Samples the texture at every fragment and writes the colors into the row
+using SampleKernel = void (*)(const Texture& texture, const SpanFragments& fragments, uint32_t* buffer_row);
+// Transforms the vertices at the given indices into clip space and projects them, writing the results at the same indices
+using TransformKernel = void (*)(const math::Matrix<4, 4>& mtx, const Vertex* vertices, const uint32_t* indices, size_t count, TransformedVertex* transformed);
+
+struct KernelVariant {
+    CpuLevel level;
+    const char* name;
+};
+
+// Every variant produces exactly the same results as the scalar one, only faster
+struct Kernels {
+    ClearKernel clear;
+    KernelVariant clear_variant;
+    SpanKernel draw_span;
+    KernelVariant draw_span_variant;
+    SampleKernel sample;
+    KernelVariant sample_variant;
+    TransformKernel transform;
+    KernelVariant transform_variant;
+};
+
+// The index of the lowest set bit, the mask must not be zero
+inline uint32_t count_trailing_zeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline uint32_t count_set_bits(uint32_t mask) {
+#if defined(_MSC_VER)
+    return __popcnt(mask);
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+// Maps the clip space position to [0, 1] on the screen axes and keeps w for the depth sorting
+inline Vertex project_vertex(const Vertex& vertex, const math::Vector<4>& vector) {
+    assert(vector.data[3] != 0.f);
+    Vertex vertex_out = vertex;
+    vertex_out.x = (vector.data[0] / vector.data[3] + 1.f) / 2.f;
+    vertex_out.y = (vector.data[1] / vector.data[3] + 1.f) / 2.f;
+    vertex_out.z = vector.data[2] / vector.data[3];
+    vertex_out.w = vector.data[3];
+    return vertex_out;
+}
+
+// Depth tests a single pixel, the scalar span kernel and the tails of the vector ones go through here
+inline void draw_span_pixel(const ScreenTriangle& triangle, int64_t x, float py, float* zbuffer_row, SpanFragments& fragments) {
+    const float* tx = triangle.x;
+    const float* ty = triangle.y;
+    const float px = static_cast<float>(x);
+    const float a = ((tx[1] - px) * (ty[2] - py) - (tx[2] - px) * (ty[1] - py)) / triangle.barycentric_denom;
+    const float b = ((tx[2] - px) * (ty[0] - py) - (tx[0] - px) * (ty[2] - py)) / triangle.barycentric_denom;
+    const float c = 1.f - a - b;
+    const float z = triangle.z[0] * a + triangle.z[1] * b + triangle.z[2] * c;
+    if (z < zbuffer_row[x]) {
+        zbuffer_row[x] = z;
+        fragments.x[fragments.count] = static_cast<uint32_t>(x);
+        fragments.u[fragments.count] = triangle.u[0] * a + triangle.u[1] * b + triangle.u[2] * c;
+        fragments.v[fragments.count] = triangle.v[0] * a + triangle.v[1] * b + triangle.v[2] * c;
+        fragments.count++;
+    }
+}
+
+// Texture coordinates outside of [0, 1) wrap around. Negative ones go through a signed conversion, a direct one to
+// uint32_t is undefined and compiles to different instructions depending on the target.
+inline uint32_t sample_texel(const Texture& texture, float u, float v) {
+    auto ub = static_cast<uint32_t>(static_cast<int64_t>(u * texture.width));
+    auto vb = static_cast<uint32_t>(static_cast<int64_t>(v * texture.height));
+    const uint32_t x = ub >= texture.width ? ub % texture.width : ub;
+    const uint32_t y = vb >= texture.height ? vb % texture.height : vb;
+    return texture.texels[y * texture.width + x] | 0xff000000;
+}
+
+// The kernels for the detected CPU, or for the level in SOFTWARE_RENDERER_CPU if it is set and supported.
+// The choice is made and logged once, on the first call.
+const Kernels& get_kernels();
+// The best kernels up to the given level, which has to be supported by the CPU
+Kernels get_kernels(CpuLevel level);
+
+void set_scalar_kernels(Kernels& kernels);
+#if defined(KERNELS_X86)
+void set_sse42_kernels(Kernels& kernels);
+void set_avx2_kernels(Kernels& kernels);
+void set_avx512_kernels(Kernels& kernels);
+#endif
+}
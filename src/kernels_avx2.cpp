@@ -0,0 +1,188 @@
+#include "kernels.h"
+#include "frustum.h"
+
+#if defined(KERNELS_X86)
+#include <cstring>
+#include <immintrin.h>
+
+// Products are never fused into the following sums, so that the results round exactly like the scalar kernels
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace renderer {
+namespace {
+KERNEL_TARGET("avx2")
+void clear_avx2(uint32_t* buffer, float* zbuffer, size_t count, uint32_t color, float depth) {
+    const __m256i colors = _mm256_set1_epi32(static_cast<int32_t>(color));
+    const __m256 depths = _mm256_set1_ps(depth);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer + i), colors);
+        _mm256_storeu_ps(zbuffer + i, depths);
+    }
+    for (; i < count; i++) {
+        buffer[i] = color;
+        zbuffer[i] = depth;
+    }
+}
+
+// Eight pixels at a time, with the products and sums in the same order as draw_span_pixel
+KERNEL_TARGET("avx2")
+void draw_span_avx2(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, float* zbuffer_row, SpanFragments& fragments) {
+    const float py = static_cast<float>(y);
+    const __m256 x0 = _mm256_set1_ps(triangle.x[0]);
+    const __m256 x1v = _mm256_set1_ps(triangle.x[1]);
+    const __m256 x2v = _mm256_set1_ps(triangle.x[2]);
+    const __m256 dy0 = _mm256_set1_ps(triangle.y[0] - py);
+    const __m256 dy1 = _mm256_set1_ps(triangle.y[1] - py);
+    const __m256 dy2 = _mm256_set1_ps(triangle.y[2] - py);
+    const __m256 denom = _mm256_set1_ps(triangle.barycentric_denom);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    fragments.count = 0;
+    int64_t x = x1;
+    for (; x + 7 <= x2; x += 8) {
+        const __m256 px = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(x)), lanes));
+        const __m256 a = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(x1v, px), dy2), _mm256_mul_ps(_mm256_sub_ps(x2v, px), dy1)), denom);
+        const __m256 b = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(x2v, px), dy0), _mm256_mul_ps(_mm256_sub_ps(x0, px), dy2)), denom);
+        const __m256 c = _mm256_sub_ps(_mm256_sub_ps(one, a), b);
+        const __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.z[0]), a), _mm256_mul_ps(_mm256_set1_ps(triangle.z[1]), b)),
+                                       _mm256_mul_ps(_mm256_set1_ps(triangle.z[2]), c));
+
+        const __m256 depth = _mm256_loadu_ps(zbuffer_row + x);
+        const __m256 passes = _mm256_cmp_ps(z, depth, _CMP_LT_OQ);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(passes));
+        if (mask == 0) {
+            continue;
+        }
+        _mm256_storeu_ps(zbuffer_row + x, _mm256_blendv_ps(depth, z, passes));
+
+        alignas(32) float u[8];
+        alignas(32) float v[8];
+        _mm256_store_ps(u, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.u[0]), a), _mm256_mul_ps(_mm256_set1_ps(triangle.u[1]), b)),
+                                         _mm256_mul_ps(_mm256_set1_ps(triangle.u[2]), c)));
+        _mm256_store_ps(v, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.v[0]), a), _mm256_mul_ps(_mm256_set1_ps(triangle.v[1]), b)),
+                                         _mm256_mul_ps(_mm256_set1_ps(triangle.v[2]), c)));
+        while (mask != 0) {
+            const uint32_t lane = count_trailing_zeros(mask);
+            mask &= mask - 1;
+            fragments.x[fragments.count] = static_cast<uint32_t>(x + lane);
+            fragments.u[fragments.count] = u[lane];
+            fragments.v[fragments.count] = v[lane];
+            fragments.count++;
+        }
+    }
+    for (; x <= x2; x++) {
+        draw_span_pixel(triangle, x, py, zbuffer_row, fragments);
+    }
+}
+
+// Gathers eight texels at a time, groups with coordinates that need wrapping go through sample_texel
+KERNEL_TARGET("avx2")
+void sample_avx2(const Texture& texture, const SpanFragments& fragments, uint32_t* buffer_row) {
+    const __m256 width = _mm256_set1_ps(static_cast<float>(texture.width));
+    const __m256 height = _mm256_set1_ps(static_cast<float>(texture.height));
+    const __m256i max_x = _mm256_set1_epi32(static_cast<int32_t>(texture.width - 1));
+    const __m256i max_y = _mm256_set1_epi32(static_cast<int32_t>(texture.height - 1));
+    const __m256i row_length = _mm256_set1_epi32(static_cast<int32_t>(texture.width));
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int32_t>(0xff000000));
+    const auto texels = reinterpret_cast<const int*>(texture.texels);
+
+    uint32_t i = 0;
+    for (; i + 8 <= fragments.count; i += 8) {
+        const __m256i x = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(fragments.u + i), width));
+        const __m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(fragments.v + i), height));
+        // Unsigned x <= width - 1, negative coordinates wrap like in the scalar conversion
+        const __m256i inside = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_min_epu32(x, max_x), x), _mm256_cmpeq_epi32(_mm256_min_epu32(y, max_y), y));
+        if (_mm256_movemask_epi8(inside) != -1) {
+            for (uint32_t j = i; j < i + 8; j++) {
+                buffer_row[fragments.x[j]] = sample_texel(texture, fragments.u[j], fragments.v[j]);
+            }
+            continue;
+        }
+
+        const __m256i indices = _mm256_add_epi32(_mm256_mullo_epi32(y, row_length), x);
+        alignas(32) uint32_t colors[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(colors), _mm256_or_si256(_mm256_i32gather_epi32(texels, indices, 4), alpha));
+        for (uint32_t j = 0; j < 8; j++) {
+            buffer_row[fragments.x[i + j]] = colors[j];
+        }
+    }
+    for (; i < fragments.count; i++) {
+        buffer_row[fragments.x[i]] = sample_texel(texture, fragments.u[i], fragments.v[i]);
+    }
+}
+
+// Two vertices at a time, one per 128-bit lane, with the products and sums in the same order as math::mul
+KERNEL_TARGET("avx2")
+void transform_avx2(const math::Matrix<4, 4>& mtx, const Vertex* vertices, const uint32_t* indices, size_t count, TransformedVertex* transformed) {
+    __m128 row0 = _mm_loadu_ps(mtx.data);
+    __m128 row1 = _mm_loadu_ps(mtx.data + 4);
+    __m128 row2 = _mm_loadu_ps(mtx.data + 8);
+    __m128 row3 = _mm_loadu_ps(mtx.data + 12);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    const __m256 c0 = _mm256_insertf128_ps(_mm256_castps128_ps256(row0), row0, 1);
+    const __m256 c1 = _mm256_insertf128_ps(_mm256_castps128_ps256(row1), row1, 1);
+    const __m256 c2 = _mm256_insertf128_ps(_mm256_castps128_ps256(row2), row2, 1);
+    const __m256 c3 = _mm256_insertf128_ps(_mm256_castps128_ps256(row3), row3, 1);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const Vertex* pair[2] = {&vertices[indices[i]], &vertices[indices[i + 1]]};
+        const __m256 position = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pair[0]->xyzw.data)), _mm_loadu_ps(pair[1]->xyzw.data), 1);
+        __m256 clip = _mm256_mul_ps(c0, _mm256_permute_ps(position, _MM_SHUFFLE(0, 0, 0, 0)));
+        clip = _mm256_add_ps(clip, _mm256_mul_ps(c1, _mm256_permute_ps(position, _MM_SHUFFLE(1, 1, 1, 1))));
+        clip = _mm256_add_ps(clip, _mm256_mul_ps(c2, _mm256_permute_ps(position, _MM_SHUFFLE(2, 2, 2, 2))));
+        clip = _mm256_add_ps(clip, _mm256_mul_ps(c3, _mm256_permute_ps(position, _MM_SHUFFLE(3, 3, 3, 3))));
+
+        // x and y are mapped to [0, 1], z is divided by w and w is kept
+        const __m256 ndc = _mm256_div_ps(clip, _mm256_permute_ps(clip, _MM_SHUFFLE(3, 3, 3, 3)));
+        const __m256 screen = _mm256_mul_ps(_mm256_add_ps(ndc, one), half);
+        const __m256 projected = _mm256_blend_ps(_mm256_blend_ps(screen, ndc, 0x44), clip, 0x88);
+
+        alignas(32) float clip_values[8];
+        alignas(32) float projected_values[8];
+        _mm256_store_ps(clip_values, clip);
+        _mm256_store_ps(projected_values, projected);
+        for (size_t j = 0; j < 2; j++) {
+            math::Vector<4> vector;
+            std::memcpy(vector.data, clip_values + j * 4, sizeof(vector.data));
+            TransformedVertex& out = transformed[indices[i + j]];
+            out.clip_code = get_clip_code(vector);
+            if ((out.clip_code & CLIP_NEAR) == 0) {
+                out.vertex = *pair[j];
+                std::memcpy(out.vertex.xyzw.data, projected_values + j * 4, sizeof(out.vertex.xyzw.data));
+            }
+        }
+    }
+    for (; i < count; i++) {
+        const uint32_t index = indices[i];
+        const math::Vector<4> vector = math::mul(mtx, vertices[index].xyzw);
+        TransformedVertex& out = transformed[index];
+        out.clip_code = get_clip_code(vector);
+        if ((out.clip_code & CLIP_NEAR) == 0) {
+            out.vertex = project_vertex(vertices[index], vector);
+        }
+    }
+}
+}
+
+void set_avx2_kernels(Kernels& kernels) {
+    const KernelVariant variant = {CpuLevel::AVX2, "avx2"};
+    kernels.clear = clear_avx2;
+    kernels.clear_variant = variant;
+    kernels.draw_span = draw_span_avx2;
+    kernels.draw_span_variant = variant;
+    kernels.sample = sample_avx2;
+    kernels.sample_variant = variant;
+    kernels.transform = transform_avx2;
+    kernels.transform_variant = variant;
+}
+}
+#endif
@@ -0,0 +1,173 @@
+#include "kernels.h"
+#include "frustum.h"
+
+#if defined(KERNELS_X86)
+#include <cstring>
+#include <immintrin.h>
+
+// Products are never fused into the following sums, so that the results round exactly like the scalar kernels
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace renderer {
+namespace {
+KERNEL_TARGET("avx512f")
+void clear_avx512(uint32_t* buffer, float* zbuffer, size_t count, uint32_t color, float depth) {
+    const __m512i colors = _mm512_set1_epi32(static_cast<int32_t>(color));
+    const __m512 depths = _mm512_set1_ps(depth);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_si512(buffer + i, colors);
+        _mm512_storeu_ps(zbuffer + i, depths);
+    }
+    const __mmask16 tail = static_cast<__mmask16>((1u << (count - i)) - 1);
+    _mm512_mask_storeu_epi32(buffer + i, tail, colors);
+    _mm512_mask_storeu_ps(zbuffer + i, tail, depths);
+}
+
+// Sixteen pixels at a time, the tail is masked and the passing fragments are compressed into the list
+KERNEL_TARGET("avx512f")
+void draw_span_avx512(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, float* zbuffer_row, SpanFragments& fragments) {
+    const float py = static_cast<float>(y);
+    const __m512 x0 = _mm512_set1_ps(triangle.x[0]);
+    const __m512 x1v = _mm512_set1_ps(triangle.x[1]);
+    const __m512 x2v = _mm512_set1_ps(triangle.x[2]);
+    const __m512 dy0 = _mm512_set1_ps(triangle.y[0] - py);
+    const __m512 dy1 = _mm512_set1_ps(triangle.y[1] - py);
+    const __m512 dy2 = _mm512_set1_ps(triangle.y[2] - py);
+    const __m512 denom = _mm512_set1_ps(triangle.barycentric_denom);
+    const __m512 one = _mm512_set1_ps(1.f);
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    fragments.count = 0;
+    for (int64_t x = x1; x <= x2; x += 16) {
+        const __mmask16 valid = x2 - x >= 15 ? static_cast<__mmask16>(0xffff) : static_cast<__mmask16>((1u << (x2 - x + 1)) - 1);
+        const __m512i xs = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(x)), lanes);
+        const __m512 px = _mm512_cvtepi32_ps(xs);
+        const __m512 a = _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_sub_ps(x1v, px), dy2), _mm512_mul_ps(_mm512_sub_ps(x2v, px), dy1)), denom);
+        const __m512 b = _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_sub_ps(x2v, px), dy0), _mm512_mul_ps(_mm512_sub_ps(x0, px), dy2)), denom);
+        const __m512 c = _mm512_sub_ps(_mm512_sub_ps(one, a), b);
+        const __m512 z = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(triangle.z[0]), a), _mm512_mul_ps(_mm512_set1_ps(triangle.z[1]), b)),
+                                       _mm512_mul_ps(_mm512_set1_ps(triangle.z[2]), c));
+
+        const __m512 depth = _mm512_maskz_loadu_ps(valid, zbuffer_row + x);
+        const __mmask16 passes = _mm512_mask_cmp_ps_mask(valid, z, depth, _CMP_LT_OQ);
+        if (passes == 0) {
+            continue;
+        }
+        _mm512_mask_storeu_ps(zbuffer_row + x, passes, z);
+
+        const __m512 u = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(triangle.u[0]), a), _mm512_mul_ps(_mm512_set1_ps(triangle.u[1]), b)),
+                                       _mm512_mul_ps(_mm512_set1_ps(triangle.u[2]), c));
+        const __m512 v = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(triangle.v[0]), a), _mm512_mul_ps(_mm512_set1_ps(triangle.v[1]), b)),
+                                       _mm512_mul_ps(_mm512_set1_ps(triangle.v[2]), c));
+        _mm512_mask_compressstoreu_epi32(fragments.x + fragments.count, passes, xs);
+        _mm512_mask_compressstoreu_ps(fragments.u + fragments.count, passes, u);
+        _mm512_mask_compressstoreu_ps(fragments.v + fragments.count, passes, v);
+        fragments.count += count_set_bits(passes);
+    }
+}
+
+// Gathers and scatters sixteen texels at a time, groups with coordinates that need wrapping go through sample_texel
+KERNEL_TARGET("avx512f")
+void sample_avx512(const Texture& texture, const SpanFragments& fragments, uint32_t* buffer_row) {
+    const __m512 width = _mm512_set1_ps(static_cast<float>(texture.width));
+    const __m512 height = _mm512_set1_ps(static_cast<float>(texture.height));
+    const __m512i row_length = _mm512_set1_epi32(static_cast<int32_t>(texture.width));
+    const __m512i alpha = _mm512_set1_epi32(static_cast<int32_t>(0xff000000));
+
+    for (uint32_t i = 0; i < fragments.count; i += 16) {
+        const uint32_t remaining = fragments.count - i;
+        const __mmask16 valid = remaining >= 16 ? static_cast<__mmask16>(0xffff) : static_cast<__mmask16>((1u << remaining) - 1);
+        const __m512i x = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_maskz_loadu_ps(valid, fragments.u + i), width));
+        const __m512i y = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_maskz_loadu_ps(valid, fragments.v + i), height));
+        const __mmask16 inside = _mm512_mask_cmplt_epu32_mask(_mm512_cmplt_epu32_mask(x, row_length), y, _mm512_set1_epi32(static_cast<int32_t>(texture.height)));
+        if ((inside & valid) != valid) {
+            for (uint32_t j = i; j < i + 16 && j < fragments.count; j++) {
+                buffer_row[fragments.x[j]] = sample_texel(texture, fragments.u[j], fragments.v[j]);
+            }
+            continue;
+        }
+
+        const __m512i indices = _mm512_add_epi32(_mm512_mullo_epi32(y, row_length), x);
+        const __m512i colors = _mm512_or_si512(_mm512_mask_i32gather_epi32(alpha, valid, indices, texture.texels, 4), alpha);
+        const __m512i xs = _mm512_maskz_loadu_epi32(valid, fragments.x + i);
+        _mm512_mask_i32scatter_epi32(buffer_row, valid, xs, colors, 4);
+    }
+}
+
+// Four vertices at a time, one per 128-bit lane, with the products and sums in the same order as math::mul
+KERNEL_TARGET("avx512f")
+void transform_avx512(const math::Matrix<4, 4>& mtx, const Vertex* vertices, const uint32_t* indices, size_t count, TransformedVertex* transformed) {
+    __m128 row0 = _mm_loadu_ps(mtx.data);
+    __m128 row1 = _mm_loadu_ps(mtx.data + 4);
+    __m128 row2 = _mm_loadu_ps(mtx.data + 8);
+    __m128 row3 = _mm_loadu_ps(mtx.data + 12);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    const __m512 c0 = _mm512_broadcast_f32x4(row0);
+    const __m512 c1 = _mm512_broadcast_f32x4(row1);
+    const __m512 c2 = _mm512_broadcast_f32x4(row2);
+    const __m512 c3 = _mm512_broadcast_f32x4(row3);
+    const __m512 one = _mm512_set1_ps(1.f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const Vertex* group[4] = {&vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]], &vertices[indices[i + 3]]};
+        __m512 position = _mm512_castps128_ps512(_mm_loadu_ps(group[0]->xyzw.data));
+        position = _mm512_insertf32x4(position, _mm_loadu_ps(group[1]->xyzw.data), 1);
+        position = _mm512_insertf32x4(position, _mm_loadu_ps(group[2]->xyzw.data), 2);
+        position = _mm512_insertf32x4(position, _mm_loadu_ps(group[3]->xyzw.data), 3);
+        __m512 clip = _mm512_mul_ps(c0, _mm512_permute_ps(position, _MM_SHUFFLE(0, 0, 0, 0)));
+        clip = _mm512_add_ps(clip, _mm512_mul_ps(c1, _mm512_permute_ps(position, _MM_SHUFFLE(1, 1, 1, 1))));
+        clip = _mm512_add_ps(clip, _mm512_mul_ps(c2, _mm512_permute_ps(position, _MM_SHUFFLE(2, 2, 2, 2))));
+        clip = _mm512_add_ps(clip, _mm512_mul_ps(c3, _mm512_permute_ps(position, _MM_SHUFFLE(3, 3, 3, 3))));
+
+        // x and y are mapped to [0, 1], z is divided by w and w is kept
+        const __m512 ndc = _mm512_div_ps(clip, _mm512_permute_ps(clip, _MM_SHUFFLE(3, 3, 3, 3)));
+        const __m512 screen = _mm512_mul_ps(_mm512_add_ps(ndc, one), half);
+        const __m512 projected = _mm512_mask_blend_ps(0x8888, _mm512_mask_blend_ps(0x4444, screen, ndc), clip);
+
+        alignas(64) float clip_values[16];
+        alignas(64) float projected_values[16];
+        _mm512_store_ps(clip_values, clip);
+        _mm512_store_ps(projected_values, projected);
+        for (size_t j = 0; j < 4; j++) {
+            math::Vector<4> vector;
+            std::memcpy(vector.data, clip_values + j * 4, sizeof(vector.data));
+            TransformedVertex& out = transformed[indices[i + j]];
+            out.clip_code = get_clip_code(vector);
+            if ((out.clip_code & CLIP_NEAR) == 0) {
+                out.vertex = *group[j];
+                std::memcpy(out.vertex.xyzw.data, projected_values + j * 4, sizeof(out.vertex.xyzw.data));
+            }
+        }
+    }
+    for (; i < count; i++) {
+        const uint32_t index = indices[i];
+        const math::Vector<4> vector = math::mul(mtx, vertices[index].xyzw);
+        TransformedVertex& out = transformed[index];
+        out.clip_code = get_clip_code(vector);
+        if ((out.clip_code & CLIP_NEAR) == 0) {
+            out.vertex = project_vertex(vertices[index], vector);
+        }
+    }
+}
+}
+
+void set_avx512_kernels(Kernels& kernels) {
+    const KernelVariant variant = {CpuLevel::AVX512, "avx512"};
+    kernels.clear = clear_avx512;
+    kernels.clear_variant = variant;
+    kernels.draw_span = draw_span_avx512;
+    kernels.draw_span_variant = variant;
+    kernels.sample = sample_avx512;
+    kernels.sample_variant = variant;
+    kernels.transform = transform_avx512;
+    kernels.transform_variant = variant;
+}
+}
+#endif
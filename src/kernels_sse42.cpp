@@ -0,0 +1,74 @@
+#include "kernels.h"
+
+#if defined(KERNELS_X86)
+#include <immintrin.h>
+
+// Products are never fused into the following sums, so that the results round exactly like the scalar kernels
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace renderer {
+namespace {
+// Four pixels at a time, with the products and sums in the same order as draw_span_pixel
+KERNEL_TARGET("sse4.2")
+void draw_span_sse42(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, float* zbuffer_row, SpanFragments& fragments) {
+    const float py = static_cast<float>(y);
+    const __m128 x0 = _mm_set1_ps(triangle.x[0]);
+    const __m128 x1v = _mm_set1_ps(triangle.x[1]);
+    const __m128 x2v = _mm_set1_ps(triangle.x[2]);
+    const __m128 dy0 = _mm_set1_ps(triangle.y[0] - py);
+    const __m128 dy1 = _mm_set1_ps(triangle.y[1] - py);
+    const __m128 dy2 = _mm_set1_ps(triangle.y[2] - py);
+    const __m128 denom = _mm_set1_ps(triangle.barycentric_denom);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+    fragments.count = 0;
+    int64_t x = x1;
+    for (; x + 3 <= x2; x += 4) {
+        const __m128 px = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(x)), lanes));
+        const __m128 a = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x1v, px), dy2), _mm_mul_ps(_mm_sub_ps(x2v, px), dy1)), denom);
+        const __m128 b = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x2v, px), dy0), _mm_mul_ps(_mm_sub_ps(x0, px), dy2)), denom);
+        const __m128 c = _mm_sub_ps(_mm_sub_ps(one, a), b);
+        const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.z[0]), a), _mm_mul_ps(_mm_set1_ps(triangle.z[1]), b)),
+                                    _mm_mul_ps(_mm_set1_ps(triangle.z[2]), c));
+
+        const __m128 depth = _mm_loadu_ps(zbuffer_row + x);
+        const __m128 passes = _mm_cmplt_ps(z, depth);
+        int mask = _mm_movemask_ps(passes);
+        if (mask == 0) {
+            continue;
+        }
+        _mm_storeu_ps(zbuffer_row + x, _mm_blendv_ps(depth, z, passes));
+
+        alignas(16) float u[4];
+        alignas(16) float v[4];
+        _mm_store_ps(u, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.u[0]), a), _mm_mul_ps(_mm_set1_ps(triangle.u[1]), b)),
+                                   _mm_mul_ps(_mm_set1_ps(triangle.u[2]), c)));
+        _mm_store_ps(v, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.v[0]), a), _mm_mul_ps(_mm_set1_ps(triangle.v[1]), b)),
+                                   _mm_mul_ps(_mm_set1_ps(triangle.v[2]), c)));
+        while (mask != 0) {
+            const uint32_t lane = count_trailing_zeros(mask);
+            mask &= mask - 1;
+            fragments.x[fragments.count] = static_cast<uint32_t>(x + lane);
+            fragments.u[fragments.count] = u[lane];
+            fragments.v[fragments.count] = v[lane];
+            fragments.count++;
+        }
+    }
+    for (; x <= x2; x++) {
+        draw_span_pixel(triangle, x, py, zbuffer_row, fragments);
+    }
+}
+}
+
+void set_sse42_kernels(Kernels& kernels) {
+    const KernelVariant variant = {CpuLevel::SSE42, "sse4.2"};
+    kernels.draw_span = draw_span_sse42;
+    kernels.draw_span_variant = variant;
+}
+}
+#endif
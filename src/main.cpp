@@ -1,8 +1,26 @@
+#include "allocation_check.h"
 #include "color.h"
+#include "bench.h"
+#include "command_list.h"
+#include "export.h"
+#include "frame_pipeline.h"
+#include "frame_presenter.h"
+#include "frame_timer.h"
+#include "golden.h"
 #include "model.h"
+#include "render_target.h"
 #include "renderer.h"
+#include "resolution.h"
+#include "shader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <ghc/filesystem.hpp>
 #include <SDL2/SDL.h>
 
@@ -10,12 +28,168 @@ constexpr uint16_t DEFAULT_WIDTH = 800;
 constexpr uint16_t DEFAULT_HEIGHT = 600;
 constexpr renderer::Color DEFAULT_CLEAR_COLOR {255, 255, 255, 255};
 
+// WxH, left unchanged when malformed
+void parse_size(const std::string& size, uint16_t& width, uint16_t& height) {
+    const size_t separator = size.find('x');
+    if (separator != std::string::npos) {
+        width = static_cast<uint16_t>(std::clamp(std::stoi(size.substr(0, separator)), 1, 8192));
+        height = static_cast<uint16_t>(std::clamp(std::stoi(size.substr(separator + 1)), 1, 8192));
+    }
+}
+
+// Converts a rect of the target into the same pixels of the window surface
+void copy_to_surface(const renderer::RenderTarget& target, const renderer::Rect& rect, SDL_Surface* surface) {
+    const auto* pixels = reinterpret_cast<const uint8_t*>(target.get_color_row(rect.y1) + rect.x1);
+    auto* surface_pixels = static_cast<uint8_t*>(surface->pixels) + rect.y1 * surface->pitch + rect.x1 * surface->format->BytesPerPixel;
+    SDL_ConvertPixels(rect.x2 - rect.x1, rect.y2 - rect.y1, SDL_PIXELFORMAT_ARGB8888, pixels, static_cast<int>(target.get_pitch()),
+                      surface->format->format, surface_pixels, surface->pitch);
+}
+
+// --golden [--update] [--tolerance N] [--golden-dir DIR] renders the reference scenes headlessly instead of opening a window
+renderer::GoldenOptions parse_golden_options(const ghc::filesystem::path& data_dir, const std::vector<std::string>& args) {
+    renderer::GoldenOptions options;
+    options.data_dir = data_dir.string();
+    options.golden_dir = (data_dir / "golden").string();
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--update") {
+            options.update = true;
+        } else if (args[i] == "--tolerance" && i + 1 < args.size()) {
+            options.tolerance = static_cast<uint8_t>(std::clamp(std::stoi(args[++i]), 0, 255));
+        } else if (args[i] == "--golden-dir" && i + 1 < args.size()) {
+            options.golden_dir = args[++i];
+        }
+    }
+    return options;
+}
+
+// --alloc-check [--frames N] [--warmup N] [--size WxH] fails when a frame allocates after the warm-up
+renderer::AllocationCheckOptions parse_allocation_check_options(const ghc::filesystem::path& data_dir, const std::vector<std::string>& args) {
+    renderer::AllocationCheckOptions options;
+    options.data_dir = data_dir.string();
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--frames" && i + 1 < args.size()) {
+            options.frame_count = std::max(std::stoi(args[++i]), 1);
+        } else if (args[i] == "--warmup" && i + 1 < args.size()) {
+            options.warmup_frames = std::max(std::stoi(args[++i]), 0);
+        } else if (args[i] == "--size" && i + 1 < args.size()) {
+            parse_size(args[++i], options.width, options.height);
+        }
+    }
+    return options;
+}
+
+// --bench [--save FILE] [--compare FILE] [--max-regression PERCENT] times the math and transform kernels
+renderer::BenchOptions parse_bench_options(const std::vector<std::string>& args) {
+    renderer::BenchOptions options;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--save" && i + 1 < args.size()) {
+            options.save_path = args[++i];
+        } else if (args[i] == "--compare" && i + 1 < args.size()) {
+            options.compare_path = args[++i];
+        } else if (args[i] == "--max-regression" && i + 1 < args.size()) {
+            options.max_regression = std::stof(args[++i]);
+        }
+    }
+    return options;
+}
+
+// --export [--frames N] [--format ppm|bmp|raw] [--output DIR] [--size WxH] [--queue N] [--dynamic-resolution MS]
+// [--upscale nearest|bilinear] writes a turntable sequence to disk
+renderer::ExportOptions parse_export_options(const ghc::filesystem::path& data_dir, const std::vector<std::string>& args) {
+    renderer::ExportOptions options;
+    options.data_dir = data_dir.string();
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--frames" && i + 1 < args.size()) {
+            options.frame_count = std::max(std::stoi(args[++i]), 1);
+        } else if (args[i] == "--format" && i + 1 < args.size()) {
+            if (!renderer::parse_image_format(args[++i], options.format)) {
+                std::cerr << "Unknown format " << args[i] << ", using ppm" << std::endl;
+            }
+        } else if (args[i] == "--output" && i + 1 < args.size()) {
+            options.output_dir = args[++i];
+        } else if (args[i] == "--size" && i + 1 < args.size()) {
+            parse_size(args[++i], options.width, options.height);
+        } else if (args[i] == "--queue" && i + 1 < args.size()) {
+            options.queue_depth = std::max(std::stoi(args[++i]), 1);
+        } else if (args[i] == "--dynamic-resolution" && i + 1 < args.size()) {
+            options.frame_budget_ms = std::max(std::stod(args[++i]), 0.);
+        } else if (args[i] == "--upscale" && i + 1 < args.size()) {
+            if (!renderer::parse_upscale_filter(args[++i], options.upscale_filter)) {
+                std::cerr << "Unknown upscale filter " << args[i] << ", using bilinear" << std::endl;
+            }
+        }
+    }
+    return options;
+}
+
+// --stream [--output PATH|-] [--frames N] [--size WxH] writes raw BGRA frames to stdout or a named pipe
+renderer::StreamOptions parse_stream_options(const ghc::filesystem::path& data_dir, const std::vector<std::string>& args) {
+    renderer::StreamOptions options;
+    options.data_dir = data_dir.string();
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--frames" && i + 1 < args.size()) {
+            options.frame_count = std::max(std::stoi(args[++i]), 0);
+        } else if (args[i] == "--output" && i + 1 < args.size()) {
+            options.output = args[++i];
+        } else if (args[i] == "--size" && i + 1 < args.size()) {
+            parse_size(args[++i], options.width, options.height);
+        }
+    }
+    return options;
+}
+
+// --shm [--name NAME] [--slots N] [--frames N] [--size WxH] [--fps N] renders into a shared memory ring,
+// --shm-read [--name NAME] [--frames N] [--output DIR] reads one
+renderer::SharedFramesOptions parse_shared_frames_options(const ghc::filesystem::path& data_dir, const std::vector<std::string>& args) {
+    renderer::SharedFramesOptions options;
+    options.data_dir = data_dir.string();
+    options.reader = std::find(args.begin(), args.end(), "--shm-read") != args.end();
+    if (options.reader) {
+        options.frame_count = 0;
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--name" && i + 1 < args.size()) {
+            options.name = args[++i];
+        } else if (args[i] == "--slots" && i + 1 < args.size()) {
+            options.slot_count = std::max(std::stoi(args[++i]), 2);
+        } else if (args[i] == "--frames" && i + 1 < args.size()) {
+            options.frame_count = std::max(std::stoi(args[++i]), 0);
+        } else if (args[i] == "--fps" && i + 1 < args.size()) {
+            options.fps = std::max(std::stoi(args[++i]), 0);
+        } else if (args[i] == "--output" && i + 1 < args.size()) {
+            options.output_dir = args[++i];
+        } else if (args[i] == "--size" && i + 1 < args.size()) {
+            parse_size(args[++i], options.width, options.height);
+        }
+    }
+    return options;
+}
+
 int main(int argc, char* argv[]) {
+    const std::vector<std::string> args(argv + 1, argv + argc);
+    const ghc::filesystem::path data_dir = ghc::filesystem::path(argv[0]).parent_path() / "data";
+    if (std::find(args.begin(), args.end(), "--golden") != args.end()) {
+        return renderer::run_golden(parse_golden_options(data_dir, args));
+    }
+    if (std::find(args.begin(), args.end(), "--export") != args.end()) {
+        return renderer::run_export(parse_export_options(data_dir, args));
+    }
+    if (std::find(args.begin(), args.end(), "--stream") != args.end()) {
+        return renderer::run_stream(parse_stream_options(data_dir, args));
+    }
+    if (std::find(args.begin(), args.end(), "--shm") != args.end() || std::find(args.begin(), args.end(), "--shm-read") != args.end()) {
+        return renderer::run_shared_frames(parse_shared_frames_options(data_dir, args));
+    }
+    if (std::find(args.begin(), args.end(), "--alloc-check") != args.end()) {
+        return renderer::run_allocation_check(parse_allocation_check_options(data_dir, args));
+    }
+    if (std::find(args.begin(), args.end(), "--bench") != args.end()) {
+        return renderer::run_bench(parse_bench_options(args));
+    }
+
     const std::string default_window_title = "SoftwareRenderer";
 
     uint32_t current_tick = 0;
-    uint32_t delta_ticks = 0;
-    uint16_t fps = 0;
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         std::cerr << "SDL failed to initialize: " << SDL_GetError() << std::endl;
@@ -42,20 +216,99 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    SDL_Surface* surface = SDL_GetWindowSurface(window.get());
-    auto* pixels = static_cast<uint32_t*>(surface->pixels);
-
-    renderer::Renderer renderer = renderer::Renderer(window.get(), DEFAULT_WIDTH, DEFAULT_HEIGHT, DEFAULT_CLEAR_COLOR);
+    renderer::Renderer renderer(DEFAULT_CLEAR_COLOR);
+    uint16_t width = DEFAULT_WIDTH;
+    uint16_t height = DEFAULT_HEIGHT;
 
     std::unique_ptr<renderer::Model> model;
     try {
-        ghc::filesystem::path model_path = ghc::filesystem::path(argv[0]).parent_path() / "data" / "Pallas_Cat";
+        ghc::filesystem::path model_path = data_dir / "Pallas_Cat";
         model = std::make_unique<renderer::Model>(model_path.string());
     } catch (const std::runtime_error& error) {
         std::cout << "Runtime Error: " << error.what() << std::endl;
         return 1;
     }
 
+    // --pipelined prepares the geometry of a frame while the previous one is rasterized, P toggles it
+    const bool pipelined = std::find(args.begin(), args.end(), "--pipelined") != args.end();
+    renderer::FramePipeline frame_pipeline(renderer, pipelined);
+    bool toggle_pipelining = false;
+
+    // Frames are copied into the window surface on a present thread, --present-buffers 2 double and 3 triple buffers
+    size_t present_buffers = 3;
+    const auto present_buffers_arg = std::find(args.begin(), args.end(), "--present-buffers");
+    if (present_buffers_arg != args.end() && present_buffers_arg + 1 != args.end()) {
+        present_buffers = std::clamp(std::stoi(*(present_buffers_arg + 1)), 2, 8);
+    }
+    // The window surface is only a consumer of the targets, SDL converts if its format differs. Outside of the dirty rects
+    // of this frame and the previous one, both hold the clear color, so only those two rects are copied and updated.
+    // A new surface, or an exposed window, gets the whole frame.
+    std::atomic<bool> full_present_requested {true};
+    SDL_Surface* presented_surface = nullptr;
+    renderer::Rect presented_rect {};
+    renderer::FramePresenter presenter(present_buffers, width, height, [&](const renderer::RenderTarget& target) {
+        SDL_Surface* surface = SDL_GetWindowSurface(window.get());
+        if (surface == nullptr || surface->w != target.get_width() || surface->h != target.get_height()) {
+            return;
+        }
+        const renderer::Rect& dirty_rect = target.get_dirty_rect();
+        if (full_present_requested.exchange(false) || surface != presented_surface) {
+            copy_to_surface(target, renderer::Rect {0, 0, target.get_width(), target.get_height()}, surface);
+            SDL_UpdateWindowSurface(window.get());
+        } else {
+            SDL_Rect rects[2];
+            int rect_count = 0;
+            for (const renderer::Rect& rect : {presented_rect, dirty_rect}) {
+                if (!rect.is_empty()) {
+                    copy_to_surface(target, rect, surface);
+                    rects[rect_count++] = SDL_Rect {rect.x1, rect.y1, rect.x2 - rect.x1, rect.y2 - rect.y1};
+                }
+            }
+            if (rect_count > 0) {
+                SDL_UpdateWindowSurfaceRects(window.get(), rects, rect_count);
+            }
+        }
+        presented_surface = surface;
+        presented_rect = dirty_rect;
+    });
+
+    // --dynamic-resolution MS renders at a scale of the window that holds MS per frame, --upscale picks the filter
+    // that stretches it to the window. R toggles it.
+    double frame_budget_ms = 1000. / 60.;
+    bool dynamic_resolution = false;
+    renderer::UpscaleFilter upscale_filter = renderer::UpscaleFilter::Bilinear;
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] == "--dynamic-resolution") {
+            frame_budget_ms = std::max(std::stod(args[i + 1]), 1.);
+            dynamic_resolution = true;
+        } else if (args[i] == "--upscale" && !renderer::parse_upscale_filter(args[i + 1], upscale_filter)) {
+            std::cerr << "Unknown upscale filter " << args[i + 1] << ", using bilinear" << std::endl;
+        }
+    }
+    renderer::ResolutionController resolution_controller(frame_budget_ms / 1000.);
+    renderer::RenderTarget scaled_target(width, height);
+
+    renderer::CommandList command_list;
+    renderer::DebugView debug_view = renderer::DebugView::None;
+    bool fog = false;
+    const renderer::FogShader fog_shader(model->get_texels(), DEFAULT_CLEAR_COLOR, 35.f, 70.f);
+
+    // --fps-cap N paces the frames to N per second, --pacing picks how the wait is done
+    double fps_cap = 0.;
+    renderer::FramePacing pacing = renderer::FramePacing::Hybrid;
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] == "--fps-cap") {
+            fps_cap = std::max(std::stod(args[i + 1]), 0.);
+        } else if (args[i] == "--pacing" && !renderer::parse_frame_pacing(args[i + 1], pacing)) {
+            std::cerr << "Unknown pacing " << args[i + 1] << ", using hybrid" << std::endl;
+        }
+    }
+    renderer::FrameTimer frame_timer(SDL_GetPerformanceCounter, SDL_GetPerformanceFrequency());
+    frame_timer.set_frame_cap(fps_cap, pacing);
+    // The title is only rebuilt a few times per second, setting it goes through the window manager
+    constexpr uint32_t TITLE_UPDATE_TICKS = 250;
+    uint32_t title_tick = 0;
+
     current_tick = SDL_GetTicks();
 
     bool quit = false;
@@ -66,14 +319,33 @@ int main(int argc, char* argv[]) {
                 case SDL_WINDOWEVENT:
                     switch(event.window.event) {
                         case SDL_WINDOWEVENT_RESIZED:
-                            surface = SDL_GetWindowSurface(window.get());
-                            pixels = static_cast<uint32_t*>(surface->pixels);
-                            renderer.resize_window(event.window.data1, event.window.data2);
+                            width = static_cast<uint16_t>(event.window.data1);
+                            height = static_cast<uint16_t>(event.window.data2);
+                            break;
+                        case SDL_WINDOWEVENT_EXPOSED:
+                            full_present_requested = true;
                             break;
                         default:
                             break;
                     }
                     break;
+                case SDL_KEYDOWN:
+                    // D cycles through the overdraw and depth complexity heatmaps
+                    if (event.key.keysym.sym == SDLK_d) {
+                        debug_view = static_cast<renderer::DebugView>((static_cast<int>(debug_view) + 1) % 3);
+                        renderer.set_debug_view(debug_view);
+                    }
+                    // F switches between the fixed pipeline and a fog shader
+                    if (event.key.keysym.sym == SDLK_f) {
+                        fog = !fog;
+                    }
+                    if (event.key.keysym.sym == SDLK_p) {
+                        toggle_pipelining = true;
+                    }
+                    if (event.key.keysym.sym == SDLK_r) {
+                        dynamic_resolution = !dynamic_resolution;
+                    }
+                    break;
                 case SDL_QUIT:
                     quit = true;
                     break;
@@ -82,28 +354,84 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        renderer.clear_buffer(pixels);
+        renderer::RenderTarget& target = presenter.acquire(width, height);
+        renderer::RenderTarget* render_target = &target;
+        if (dynamic_resolution) {
+            uint16_t scaled_width;
+            uint16_t scaled_height;
+            renderer::ResolutionController::get_scaled_size(width, height, resolution_controller.get_scale(), scaled_width, scaled_height);
+            if (scaled_target.get_width() != scaled_width || scaled_target.get_height() != scaled_height) {
+                scaled_target.resize(scaled_width, scaled_height);
+            }
+            render_target = &scaled_target;
+        }
+        if (toggle_pipelining) {
+            frame_pipeline.set_pipelined(!frame_pipeline.is_pipelined(), *render_target);
+            toggle_pipelining = false;
+        }
+        const uint64_t render_start = SDL_GetPerformanceCounter();
+
+        renderer.reset_stats();
+        command_list.reset();
+        command_list.clear();
 
         // Draw model
         math::Matrix<4, 4> rotation_mtx1 = math::create_rotation_matrix(1.f, 0.f, 0.f, 1.6f);
         math::Matrix<4, 4> rotation_mtx2 = math::create_rotation_matrix(0.f, 0.f, 1.f, current_tick / 5000.f);
         math::Matrix<4, 4> rotation_mtx = math::mul(rotation_mtx1, rotation_mtx2);
         math::Matrix<4, 4> translation_mtx = math::create_translation_matrix(1.f, 15.f, 50.f);
-        renderer.draw_model(model.get(), pixels, rotation_mtx, translation_mtx, 60.f);
+        if (!fog) {
+            command_list.draw_model(model.get(), rotation_mtx, translation_mtx, 60.f);
+        }
 
-        // FPS
-        delta_ticks = SDL_GetTicks() - current_tick;
-        current_tick = SDL_GetTicks();
-        if (delta_ticks > 0) {
-            fps = 1000 / delta_ticks;
+        frame_pipeline.submit(command_list, *render_target);
+        if (fog) {
+            frame_pipeline.flush(*render_target);
+            renderer.draw_model_shaded(model.get(), *render_target, math::mul(translation_mtx, rotation_mtx), 60.f, fog_shader);
+        }
+        if (dynamic_resolution) {
+            resolution_controller.update(static_cast<double>(SDL_GetPerformanceCounter() - render_start) / SDL_GetPerformanceFrequency());
+            renderer::upscale(scaled_target, target, upscale_filter);
         }
 
-        const std::string title = default_window_title + " (" + std::to_string(fps) + " FPS)";
-        SDL_SetWindowTitle(window.get(), title.c_str());
+        presenter.submit(target);
+        frame_timer.end_frame();
+        current_tick = SDL_GetTicks();
+        if (current_tick - title_tick < TITLE_UPDATE_TICKS) {
+            continue;
+        }
+        title_tick = current_tick;
 
-        SDL_UpdateWindowSurface(window.get());
+        // FPS of the average frame time, and the 99th percentile that shows the stutters an average hides. The title is
+        // formatted into a fixed buffer, so that it doesn't allocate.
+        const renderer::FrameTimeStats frame_stats = frame_timer.get_stats();
+        char title[256];
+        size_t title_length = 0;
+        auto append_title = [&](int length) {
+            title_length = std::min(title_length + std::max(length, 0), sizeof(title) - 1);
+        };
+        append_title(std::snprintf(title, sizeof(title), "%s (%.0f FPS, %.2f ms p99)%s", default_window_title.c_str(), 1. / frame_stats.average,
+                                   frame_stats.p99 * 1000., frame_pipeline.is_pipelined() ? " pipelined" : ""));
+        if (dynamic_resolution) {
+            append_title(std::snprintf(title + title_length, sizeof(title) - title_length, " %ld%% resolution", std::lround(resolution_controller.get_scale() * 100.f)));
+        }
+        const renderer::Stats& stats = renderer.get_stats();
+        if (debug_view != renderer::DebugView::None && stats.covered_pixels > 0) {
+            const float average = static_cast<float>(debug_view == renderer::DebugView::Coverage ? stats.pixels_tested : stats.pixels_shaded) / stats.covered_pixels;
+            const uint64_t maximum = debug_view == renderer::DebugView::Coverage ? stats.max_coverage : stats.max_depth_passes;
+            append_title(std::snprintf(title + title_length, sizeof(title) - title_length, " depth complexity avg %f max %llu", average,
+                                       static_cast<unsigned long long>(maximum)));
+        }
+        SDL_SetWindowTitle(window.get(), title);
     }
 
+    presenter.finish();
+    const renderer::FrameTimeStats frame_stats = frame_timer.get_stats();
+    if (frame_stats.frame_count > 0) {
+        std::cout << std::fixed << std::setprecision(3) << "Last " << frame_stats.frame_count << " frames: avg " << frame_stats.average * 1000.
+                  << " ms, p50 " << frame_stats.p50 * 1000. << " ms, p95 " << frame_stats.p95 * 1000. << " ms, p99 " << frame_stats.p99 * 1000.
+                  << " ms, max " << frame_stats.max * 1000. << " ms" << std::endl;
+    }
     SDL_Quit();
 
     return 0;
@@ -1,8 +1,17 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATH_SSE
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define MATH_NEON
+#include <arm_neon.h>
+#endif
+
 namespace math {
 constexpr float PI = 3.14159265358979323846;
 
@@ -33,4 +42,93 @@ Matrix<N2, M1> mul(const Matrix<N1, M1>& l, const Matrix<N2, M2>& r) {
 
     return mtx;
 }
-}
\ No newline at end of file
+
+// The 4x4 overloads below take precedence over the template. They add the products in the same order as the template
+// and never fuse them, so the results are bit for bit the same on every path.
+
+inline Matrix<4, 4> mul(const Matrix<4, 4>& l, const Matrix<4, 4>& r) {
+    Matrix<4, 4> mtx;
+#if defined(MATH_SSE) && defined(__AVX__)
+    // Two rows of the result at a time, each 128-bit lane multiplies the rows of r by one row of l
+    const __m256 r0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(r.data));
+    const __m256 r1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(r.data + 4));
+    const __m256 r2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(r.data + 8));
+    const __m256 r3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(r.data + 12));
+    for (size_t i = 0; i < 4; i += 2) {
+        const __m256 rows = _mm256_loadu_ps(l.data + i * 4);
+        __m256 row = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+        row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+        row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+        row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(3, 3, 3, 3)), r3));
+        _mm256_storeu_ps(mtx.data + i * 4, row);
+    }
+#elif defined(MATH_SSE)
+    const __m128 r0 = _mm_loadu_ps(r.data);
+    const __m128 r1 = _mm_loadu_ps(r.data + 4);
+    const __m128 r2 = _mm_loadu_ps(r.data + 8);
+    const __m128 r3 = _mm_loadu_ps(r.data + 12);
+    for (size_t i = 0; i < 4; i++) {
+        __m128 row = _mm_mul_ps(_mm_set1_ps(l.data[i * 4]), r0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l.data[i * 4 + 1]), r1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l.data[i * 4 + 2]), r2));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l.data[i * 4 + 3]), r3));
+        _mm_storeu_ps(mtx.data + i * 4, row);
+    }
+#elif defined(MATH_NEON)
+    const float32x4_t r0 = vld1q_f32(r.data);
+    const float32x4_t r1 = vld1q_f32(r.data + 4);
+    const float32x4_t r2 = vld1q_f32(r.data + 8);
+    const float32x4_t r3 = vld1q_f32(r.data + 12);
+    for (size_t i = 0; i < 4; i++) {
+        float32x4_t row = vmulq_n_f32(r0, l.data[i * 4]);
+        row = vaddq_f32(row, vmulq_n_f32(r1, l.data[i * 4 + 1]));
+        row = vaddq_f32(row, vmulq_n_f32(r2, l.data[i * 4 + 2]));
+        row = vaddq_f32(row, vmulq_n_f32(r3, l.data[i * 4 + 3]));
+        vst1q_f32(mtx.data + i * 4, row);
+    }
+#else
+    mtx = mul<4, 4, 4, 4>(l, r);
+#endif
+    return mtx;
+}
+
+// Multiplies the matrix by count vectors, the matrix is only loaded and transposed once
+inline void mul(const Matrix<4, 4>& l, const Vector<4>* vectors, Vector<4>* out, size_t count) {
+#if defined(MATH_SSE)
+    __m128 c0 = _mm_loadu_ps(l.data);
+    __m128 c1 = _mm_loadu_ps(l.data + 4);
+    __m128 c2 = _mm_loadu_ps(l.data + 8);
+    __m128 c3 = _mm_loadu_ps(l.data + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    for (size_t i = 0; i < count; i++) {
+        const float* v = vectors[i].data;
+        __m128 vector = _mm_mul_ps(c0, _mm_set1_ps(v[0]));
+        vector = _mm_add_ps(vector, _mm_mul_ps(c1, _mm_set1_ps(v[1])));
+        vector = _mm_add_ps(vector, _mm_mul_ps(c2, _mm_set1_ps(v[2])));
+        vector = _mm_add_ps(vector, _mm_mul_ps(c3, _mm_set1_ps(v[3])));
+        _mm_storeu_ps(out[i].data, vector);
+    }
+#elif defined(MATH_NEON)
+    // De-interleaving the rows yields the columns
+    const float32x4x4_t columns = vld4q_f32(l.data);
+    for (size_t i = 0; i < count; i++) {
+        const float* v = vectors[i].data;
+        float32x4_t vector = vmulq_n_f32(columns.val[0], v[0]);
+        vector = vaddq_f32(vector, vmulq_n_f32(columns.val[1], v[1]));
+        vector = vaddq_f32(vector, vmulq_n_f32(columns.val[2], v[2]));
+        vector = vaddq_f32(vector, vmulq_n_f32(columns.val[3], v[3]));
+        vst1q_f32(out[i].data, vector);
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        out[i] = mul<4, 4, 1, 4>(l, vectors[i]);
+    }
+#endif
+}
+
+inline Vector<4> mul(const Matrix<4, 4>& l, const Vector<4>& r) {
+    Vector<4> vector;
+    mul(l, &r, &vector, 1);
+    return vector;
+}
+}
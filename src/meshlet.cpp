@@ -0,0 +1,185 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace renderer {
+namespace {
+struct Normal {
+    float x;
+    float y;
+    float z;
+};
+
+Normal get_triangle_normal(const Vertex& v1, const Vertex& v2, const Vertex& v3) {
+    const float ax = v2.x - v1.x;
+    const float ay = v2.y - v1.y;
+    const float az = v2.z - v1.z;
+    const float bx = v3.x - v1.x;
+    const float by = v3.y - v1.y;
+    const float bz = v3.z - v1.z;
+    return Normal {ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx};
+}
+
+uint32_t spread_bits(uint32_t value) {
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+uint32_t get_morton_code(float x, float y, float z, const BoundingBox& box) {
+    uint32_t code = 0;
+    const float coords[3] = {x, y, z};
+    for (size_t axis = 0; axis < 3; axis++) {
+        const float extent = box.max[axis] - box.min[axis];
+        const float t = extent > 0.f ? (coords[axis] - box.min[axis]) / extent : 0.f;
+        const auto cell = static_cast<uint32_t>(std::clamp(t, 0.f, 1.f) * 1023.f);
+        code |= spread_bits(cell) << axis;
+    }
+    return code;
+}
+
+// Triangles are grouped by the dominant axis of their normal first, so that meshlets get narrow normal cones
+uint32_t get_normal_bucket(const Normal& normal) {
+    const float ax = fabsf(normal.x);
+    const float ay = fabsf(normal.y);
+    const float az = fabsf(normal.z);
+    if (ax >= ay && ax >= az) {
+        return normal.x >= 0.f ? 0 : 1;
+    }
+    if (ay >= az) {
+        return normal.y >= 0.f ? 2 : 3;
+    }
+    return normal.z >= 0.f ? 4 : 5;
+}
+
+Meshlet create_meshlet(const std::vector<uint32_t>& index_buffer, const std::vector<Vertex>& vertex_buffer, size_t first_index, size_t index_count) {
+    Meshlet meshlet = {};
+    meshlet.first_index = static_cast<uint32_t>(first_index);
+    meshlet.index_count = static_cast<uint32_t>(index_count);
+
+    const Vertex& first_vertex = vertex_buffer[index_buffer[first_index]];
+    float min[3] = {first_vertex.x, first_vertex.y, first_vertex.z};
+    float max[3] = {min[0], min[1], min[2]};
+    for (size_t i = first_index; i < first_index + index_count; i++) {
+        const Vertex& vertex = vertex_buffer[index_buffer[i]];
+        for (size_t axis = 0; axis < 3; axis++) {
+            min[axis] = std::min(min[axis], vertex.xyzw.data[axis]);
+            max[axis] = std::max(max[axis], vertex.xyzw.data[axis]);
+        }
+    }
+
+    BoundingSphere& sphere = meshlet.bounding_sphere;
+    sphere.x = (min[0] + max[0]) / 2.f;
+    sphere.y = (min[1] + max[1]) / 2.f;
+    sphere.z = (min[2] + max[2]) / 2.f;
+
+    float radius_sq = 0.f;
+    for (size_t i = first_index; i < first_index + index_count; i++) {
+        const Vertex& vertex = vertex_buffer[index_buffer[i]];
+        const float dx = vertex.x - sphere.x;
+        const float dy = vertex.y - sphere.y;
+        const float dz = vertex.z - sphere.z;
+        radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+    }
+    sphere.radius = sqrtf(radius_sq);
+
+    std::vector<Normal> normals;
+    normals.reserve(index_count / 3);
+    Normal axis = {0.f, 0.f, 0.f};
+    for (size_t i = first_index; i < first_index + index_count; i += 3) {
+        Normal normal = get_triangle_normal(vertex_buffer[index_buffer[i]], vertex_buffer[index_buffer[i + 1]], vertex_buffer[index_buffer[i + 2]]);
+        const float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length == 0.f) {
+            continue;
+        }
+        normal = Normal {normal.x / length, normal.y / length, normal.z / length};
+        normals.push_back(normal);
+        axis.x += normal.x;
+        axis.y += normal.y;
+        axis.z += normal.z;
+    }
+
+    // A cone with a zero cosine can never be back-facing, which disables cone culling for this meshlet
+    const float axis_length = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    if (axis_length == 0.f) {
+        return meshlet;
+    }
+    axis = Normal {axis.x / axis_length, axis.y / axis_length, axis.z / axis_length};
+
+    float min_dot = 1.f;
+    for (const Normal& normal : normals) {
+        min_dot = std::min(min_dot, normal.x * axis.x + normal.y * axis.y + normal.z * axis.z);
+    }
+    if (min_dot <= 0.f) {
+        return meshlet;
+    }
+
+    meshlet.cone_axis[0] = axis.x;
+    meshlet.cone_axis[1] = axis.y;
+    meshlet.cone_axis[2] = axis.z;
+    meshlet.cone_cos = min_dot;
+    meshlet.cone_sin = sqrtf(1.f - min_dot * min_dot);
+    return meshlet;
+}
+}
+
+std::vector<Meshlet> build_meshlets(std::vector<uint32_t>& index_buffer, const std::vector<Vertex>& vertex_buffer, const BoundingBox& bounding_box) {
+    const size_t triangle_count = index_buffer.size() / 3;
+
+    std::vector<std::pair<uint64_t, uint32_t>> keys(triangle_count);
+    for (size_t triangle = 0; triangle < triangle_count; triangle++) {
+        const Vertex& v1 = vertex_buffer[index_buffer[triangle * 3]];
+        const Vertex& v2 = vertex_buffer[index_buffer[triangle * 3 + 1]];
+        const Vertex& v3 = vertex_buffer[index_buffer[triangle * 3 + 2]];
+
+        const uint32_t bucket = get_normal_bucket(get_triangle_normal(v1, v2, v3));
+        const uint32_t morton = get_morton_code((v1.x + v2.x + v3.x) / 3.f, (v1.y + v2.y + v3.y) / 3.f, (v1.z + v2.z + v3.z) / 3.f, bounding_box);
+        keys[triangle] = {(static_cast<uint64_t>(bucket) << 30) | morton, static_cast<uint32_t>(triangle)};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint32_t> sorted_buffer(triangle_count * 3);
+    for (size_t i = 0; i < triangle_count; i++) {
+        const size_t triangle = keys[i].second;
+        sorted_buffer[i * 3] = index_buffer[triangle * 3];
+        sorted_buffer[i * 3 + 1] = index_buffer[triangle * 3 + 1];
+        sorted_buffer[i * 3 + 2] = index_buffer[triangle * 3 + 2];
+    }
+    index_buffer.swap(sorted_buffer);
+
+    std::vector<Meshlet> meshlets;
+    size_t first_triangle = 0;
+    for (size_t i = 1; i <= triangle_count; i++) {
+        const bool is_full = i - first_triangle == MESHLET_MAX_TRIANGLES;
+        if (i == triangle_count || is_full || (keys[i].first >> 30) != (keys[first_triangle].first >> 30)) {
+            meshlets.push_back(create_meshlet(index_buffer, vertex_buffer, first_triangle * 3, (i - first_triangle) * 3));
+            first_triangle = i;
+        }
+    }
+    return meshlets;
+}
+
+bool is_backfacing(const Meshlet& meshlet, const float eye[3]) {
+    if (meshlet.cone_cos <= 0.f) {
+        return false;
+    }
+
+    const BoundingSphere& sphere = meshlet.bounding_sphere;
+    const float dx = sphere.x - eye[0];
+    const float dy = sphere.y - eye[1];
+    const float dz = sphere.z - eye[2];
+    const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+    if (distance <= sphere.radius) {
+        return false;
+    }
+
+    // Every triangle faces away from the eye if the closest normal of the cone still points away by more than the radius
+    const float cos_view = (dx * meshlet.cone_axis[0] + dy * meshlet.cone_axis[1] + dz * meshlet.cone_axis[2]) / distance;
+    const float sin_view = sqrtf(std::max(0.f, 1.f - cos_view * cos_view));
+    return distance * (cos_view * meshlet.cone_cos - sin_view * meshlet.cone_sin) >= sphere.radius;
+}
+}
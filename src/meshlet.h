@@ -0,0 +1,24 @@
+#pragma once
+
+#include "frustum.h"
+#include "vertex.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer {
+constexpr size_t MESHLET_MAX_TRIANGLES = 128;
+
+struct Meshlet {
+    uint32_t first_index;
+    uint32_t index_count;
+    BoundingSphere bounding_sphere;
+    float cone_axis[3];
+    float cone_cos;
+    float cone_sin;
+};
+
+// Reorders the triangles of the index buffer so that every meshlet covers a contiguous range of it
+std::vector<Meshlet> build_meshlets(std::vector<uint32_t>& index_buffer, const std::vector<Vertex>& vertex_buffer, const BoundingBox& bounding_box);
+bool is_backfacing(const Meshlet& meshlet, const float eye[3]);
+}
@@ -1,12 +1,28 @@
 #include "model.h"
+#include "simplify.h"
 #include "vertex.h"
+#include "vertex_cache.h"
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <unordered_map>
 #include <tiny_obj_loader_impl.h>
 
 namespace renderer {
+namespace {
+// The sampling kernels read 32-bit BGRA texels, the original surface is freed
+SDL_Surface* convert_texture(SDL_Surface* surface) {
+    if (surface == nullptr) {
+        return nullptr;
+    }
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(surface);
+    return converted;
+}
+}
 
-Model::Model(const std::string &path) : texture(init_texture(path)) {
+Model::Model(const std::string &path, const ModelOptions& options) : texture(init_texture(path)) {
     if (texture == nullptr) {
         throw std::runtime_error("Failed to load a texture: " + std::string(SDL_GetError()));
     }
@@ -27,10 +43,13 @@ Model::Model(const std::string &path) : texture(init_texture(path)) {
         throw std::runtime_error("Failed to load a model: " + err);
     }
 
+    // Corners sharing both the position and the texture coordinate become a single vertex
+    std::vector<uint32_t> index_buffer;
+    std::unordered_map<uint64_t, uint32_t> vertex_ids;
     for (const tinyobj::shape_t& shape : shapes) {
         size_t index_offset = 0;
 
-        vertex_buffer.resize(shape.mesh.num_face_vertices.size() * 3);
+        index_buffer.reserve(index_buffer.size() + shape.mesh.num_face_vertices.size() * 3);
 
         for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); face++) {
             // num_face_vertices must be 3 for every face
@@ -38,30 +57,210 @@ Model::Model(const std::string &path) : texture(init_texture(path)) {
 
             for (size_t vertex = 0; vertex < 3; vertex++) {
                 tinyobj::index_t idx = shape.mesh.indices[index_offset + vertex];
-                tinyobj::real_t x = attrib.vertices[3 * idx.vertex_index + 0];
-                tinyobj::real_t y = attrib.vertices[3 * idx.vertex_index + 1];
-                tinyobj::real_t z = attrib.vertices[3 * idx.vertex_index + 2];
-                tinyobj::real_t u = attrib.texcoords[2 * idx.texcoord_index + 0];
-                tinyobj::real_t v = 1.f - attrib.texcoords[2 * idx.texcoord_index + 1];
+                const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(idx.vertex_index)) << 32) | static_cast<uint32_t>(idx.texcoord_index);
+                auto [it, inserted] = vertex_ids.emplace(key, static_cast<uint32_t>(vertex_buffer.size()));
+                if (inserted) {
+                    tinyobj::real_t x = attrib.vertices[3 * idx.vertex_index + 0];
+                    tinyobj::real_t y = attrib.vertices[3 * idx.vertex_index + 1];
+                    tinyobj::real_t z = attrib.vertices[3 * idx.vertex_index + 2];
+                    tinyobj::real_t u = attrib.texcoords[2 * idx.texcoord_index + 0];
+                    tinyobj::real_t v = 1.f - attrib.texcoords[2 * idx.texcoord_index + 1];
 
-                vertex_buffer[face * 3 + vertex] = renderer::Vertex {x, y, z, 1.f, u, v};
+                    vertex_buffer.push_back(renderer::Vertex {x, y, z, 1.f, u, v});
+                }
+                index_buffer.push_back(it->second);
             }
             index_offset += 3;
         }
     }
+
+    init_geometry(std::move(index_buffer), options);
+}
+
+Model::Model(std::vector<Vertex> vertex_buffer, std::vector<uint32_t> index_buffer, SDL_Surface* texture, const ModelOptions& options)
+        : vertex_buffer(std::move(vertex_buffer)), texture(convert_texture(texture), [](SDL_Surface* surface) { SDL_FreeSurface(surface); }) {
+    if (this->texture == nullptr) {
+        throw std::runtime_error("A model needs a texture");
+    }
+    init_geometry(std::move(index_buffer), options);
+}
+
+void Model::init_geometry(std::vector<uint32_t> index_buffer, const ModelOptions& options) {
+    init_bounds();
+
+    const float acmr = get_acmr(index_buffer.data(), index_buffer.size(), VERTEX_CACHE_SIZE);
+    lods.push_back(Lod {std::move(index_buffer), {}});
+
+    if (options.build_lods) {
+        init_lods();
+    }
+
+    for (Lod& lod : lods) {
+        if (options.build_meshlets) {
+            lod.meshlets = build_meshlets(lod.index_buffer, vertex_buffer, bounding_box);
+        }
+
+        if (options.optimize_vertex_cache) {
+            if (lod.meshlets.empty()) {
+                optimize_vertex_cache(lod.index_buffer.data(), lod.index_buffer.size(), VERTEX_CACHE_SIZE);
+            }
+            for (const Meshlet& meshlet : lod.meshlets) {
+                optimize_vertex_cache(lod.index_buffer.data() + meshlet.first_index, meshlet.index_count, VERTEX_CACHE_SIZE);
+            }
+        }
+    }
+
+    if (options.optimize_vertex_cache) {
+        // Coarse levels come first, so that they read a compact prefix of the vertex buffer
+        std::vector<std::vector<uint32_t>*> index_buffers;
+        for (auto lod = lods.rbegin(); lod != lods.rend(); lod++) {
+            index_buffers.push_back(&lod->index_buffer);
+        }
+        optimize_vertex_fetch(index_buffers, vertex_buffer);
+
+        const float optimized_acmr = get_acmr(lods[0].index_buffer.data(), lods[0].index_buffer.size(), VERTEX_CACHE_SIZE);
+        std::cout << "Vertex cache ACMR: " << acmr << " -> " << optimized_acmr << std::endl;
+    }
+
+    if (options.quantize_vertices) {
+        init_quantization();
+    }
+}
+
+void Model::init_bounds() {
+    bounding_box = BoundingBox {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}};
+    if (!vertex_buffer.empty()) {
+        bounding_box = BoundingBox {
+                {vertex_buffer[0].x, vertex_buffer[0].y, vertex_buffer[0].z},
+                {vertex_buffer[0].x, vertex_buffer[0].y, vertex_buffer[0].z}
+        };
+    }
+
+    for (const Vertex& vertex : vertex_buffer) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            bounding_box.min[axis] = std::min(bounding_box.min[axis], vertex.xyzw.data[axis]);
+            bounding_box.max[axis] = std::max(bounding_box.max[axis], vertex.xyzw.data[axis]);
+        }
+    }
+
+    bounding_sphere.x = (bounding_box.min[0] + bounding_box.max[0]) / 2.f;
+    bounding_sphere.y = (bounding_box.min[1] + bounding_box.max[1]) / 2.f;
+    bounding_sphere.z = (bounding_box.min[2] + bounding_box.max[2]) / 2.f;
+
+    float radius_sq = 0.f;
+    for (const Vertex& vertex : vertex_buffer) {
+        const float dx = vertex.x - bounding_sphere.x;
+        const float dy = vertex.y - bounding_sphere.y;
+        const float dz = vertex.z - bounding_sphere.z;
+        radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+    }
+    bounding_sphere.radius = sqrtf(radius_sq);
+}
+
+void Model::init_lods() {
+    while (lods.size() < LOD_MAX_LEVELS) {
+        const std::vector<uint32_t>& index_buffer = lods.back().index_buffer;
+        if (index_buffer.size() / 3 <= LOD_MIN_TRIANGLES) {
+            break;
+        }
+
+        std::vector<uint32_t> simplified_buffer = simplify(index_buffer, vertex_buffer, index_buffer.size() / 2);
+        // Levels that barely shrink are not worth switching to, which happens once only locked vertices are left
+        if (simplified_buffer.size() > index_buffer.size() * 9 / 10) {
+            break;
+        }
+        lods.push_back(Lod {std::move(simplified_buffer), {}});
+    }
+
+    std::cout << "LOD triangles:";
+    for (const Lod& lod : lods) {
+        std::cout << " " << lod.index_buffer.size() / 3;
+    }
+    std::cout << std::endl;
+}
+
+void Model::init_quantization() {
+    float uv_min[2] = {0.f, 0.f};
+    float uv_max[2] = {0.f, 0.f};
+    if (!vertex_buffer.empty()) {
+        uv_min[0] = uv_max[0] = vertex_buffer[0].u;
+        uv_min[1] = uv_max[1] = vertex_buffer[0].v;
+    }
+    for (const Vertex& vertex : vertex_buffer) {
+        uv_min[0] = std::min(uv_min[0], vertex.u);
+        uv_min[1] = std::min(uv_min[1], vertex.v);
+        uv_max[0] = std::max(uv_max[0], vertex.u);
+        uv_max[1] = std::max(uv_max[1], vertex.v);
+    }
+
+    quantization = create_quantization(bounding_box, uv_min, uv_max);
+    quantized_vertex_buffer.reserve(vertex_buffer.size());
+    for (const Vertex& vertex : vertex_buffer) {
+        quantized_vertex_buffer.push_back(quantize_vertex(vertex, quantization));
+    }
+
+    std::cout << "Quantized vertices: " << vertex_buffer.size() * sizeof(Vertex) << " -> " << quantized_vertex_buffer.size() * sizeof(QuantizedVertex) << " bytes" << std::endl;
+    // The float vertices are only kept around for the unquantized pipeline
+    std::vector<Vertex>().swap(vertex_buffer);
 }
 
 std::unique_ptr<SDL_Surface, void (*) (SDL_Surface*)> Model::init_texture(const std::string &path) const {
     std::string file_texture = path + ".bmp";
     auto deleter = [](SDL_Surface* surface) { SDL_FreeSurface(surface); };
-    return std::unique_ptr<SDL_Surface, void (*) (SDL_Surface*)>(SDL_LoadBMP(file_texture.c_str()), deleter);
+    return std::unique_ptr<SDL_Surface, void (*) (SDL_Surface*)>(convert_texture(SDL_LoadBMP(file_texture.c_str())), deleter);
+}
+
+std::vector<Vertex> Model::expand_vertex_buffer() const {
+    if (!is_quantized()) {
+        return vertex_buffer;
+    }
+
+    std::vector<Vertex> expanded_buffer;
+    expanded_buffer.reserve(quantized_vertex_buffer.size());
+    for (const QuantizedVertex& vertex : quantized_vertex_buffer) {
+        expanded_buffer.push_back(dequantize_vertex(vertex, quantization));
+    }
+    return expanded_buffer;
+}
+
+const BoundingBox& Model::get_bounding_box() const {
+    return bounding_box;
+}
+
+const BoundingSphere& Model::get_bounding_sphere() const {
+    return bounding_sphere;
+}
+
+const std::vector<Lod>& Model::get_lods() const {
+    return lods;
+}
+
+const Quantization& Model::get_quantization() const {
+    return quantization;
+}
+
+const std::vector<QuantizedVertex>& Model::get_quantized_vertex_buffer() const {
+    return quantized_vertex_buffer;
 }
 
 const std::vector<Vertex>& Model::get_vertex_buffer() const {
     return vertex_buffer;
 }
 
+size_t Model::get_vertex_count() const {
+    return is_quantized() ? quantized_vertex_buffer.size() : vertex_buffer.size();
+}
+
 const SDL_Surface* Model::get_texture() const {
     return texture.get();
 }
+
+Texture Model::get_texels() const {
+    assert(texture->format->BytesPerPixel == 4 && texture->pitch == texture->w * 4);
+    return Texture {static_cast<const uint32_t*>(texture->pixels), static_cast<uint32_t>(texture->w), static_cast<uint32_t>(texture->h)};
+}
+
+bool Model::is_quantized() const {
+    return !quantized_vertex_buffer.empty();
+}
 }
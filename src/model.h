@@ -1,7 +1,12 @@
 #pragma once
 
+#include "frustum.h"
+#include "kernels.h"
+#include "meshlet.h"
+#include "quantization.h"
 #include "vertex.h"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -9,14 +14,50 @@
 #include <SDL2/SDL_surface.h>
 
 namespace renderer {
+constexpr size_t LOD_MAX_LEVELS = 8;
+constexpr size_t LOD_MIN_TRIANGLES = 64;
+
+struct ModelOptions {
+    bool build_lods = false;
+    bool build_meshlets = false;
+    bool optimize_vertex_cache = false;
+    bool quantize_vertices = false;
+};
+
+struct Lod {
+    std::vector<uint32_t> index_buffer;
+    std::vector<Meshlet> meshlets;
+};
+
 class Model {
 public:
-    explicit Model(const std::string& path);
+    explicit Model(const std::string& path, const ModelOptions& options = ModelOptions());
+    // Builds a model from indexed triangles in memory, the model takes ownership of the texture
+    Model(std::vector<Vertex> vertex_buffer, std::vector<uint32_t> index_buffer, SDL_Surface* texture, const ModelOptions& options = ModelOptions());
+    std::vector<Vertex> expand_vertex_buffer() const;
+    const BoundingBox& get_bounding_box() const;
+    const BoundingSphere& get_bounding_sphere() const;
+    const std::vector<Lod>& get_lods() const;
+    const Quantization& get_quantization() const;
+    const std::vector<QuantizedVertex>& get_quantized_vertex_buffer() const;
     const std::vector<Vertex>& get_vertex_buffer() const;
+    size_t get_vertex_count() const;
     const SDL_Surface* get_texture() const;
+    // The texture as 32-bit BGRA texels, it is converted when the model is loaded
+    Texture get_texels() const;
+    bool is_quantized() const;
 private:
+    void init_bounds();
+    void init_geometry(std::vector<uint32_t> index_buffer, const ModelOptions& options);
+    void init_lods();
+    void init_quantization();
     std::unique_ptr<SDL_Surface, void (*) (SDL_Surface*)> init_texture(const std::string& path) const;
 
+    BoundingBox bounding_box;
+    BoundingSphere bounding_sphere;
+    std::vector<Lod> lods;
+    Quantization quantization {};
+    std::vector<QuantizedVertex> quantized_vertex_buffer;
     std::vector<Vertex> vertex_buffer;
     std::unique_ptr<SDL_Surface, void (*) (SDL_Surface*)> texture;
 };
@@ -0,0 +1,140 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace renderer {
+namespace {
+template <DepthMode Depth, Interpolation Interp>
+void draw_span(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, float* zbuffer_row, SpanFragments& fragments) {
+    const float* tx = triangle.x;
+    const float* ty = triangle.y;
+    const float* inv_w = triangle.inv_w;
+    const float py = static_cast<float>(y);
+
+    // Perspective correct attributes are interpolated divided by w and divided back per pixel
+    float u[3];
+    float v[3];
+    for (size_t i = 0; i < 3; i++) {
+        u[i] = Interp == Interpolation::Perspective ? triangle.u[i] * inv_w[i] : triangle.u[i];
+        v[i] = Interp == Interpolation::Perspective ? triangle.v[i] * inv_w[i] : triangle.v[i];
+    }
+
+    fragments.count = 0;
+    for (int64_t x = x1; x <= x2; x++) {
+        const float px = static_cast<float>(x);
+        const float a = ((tx[1] - px) * (ty[2] - py) - (tx[2] - px) * (ty[1] - py)) / triangle.barycentric_denom;
+        const float b = ((tx[2] - px) * (ty[0] - py) - (tx[0] - px) * (ty[2] - py)) / triangle.barycentric_denom;
+        const float c = 1.f - a - b;
+
+        if constexpr (Depth != DepthMode::Off) {
+            const float z = triangle.z[0] * a + triangle.z[1] * b + triangle.z[2] * c;
+            if (!(z < zbuffer_row[x])) {
+                continue;
+            }
+            if constexpr (Depth == DepthMode::TestAndWrite) {
+                zbuffer_row[x] = z;
+            }
+        }
+
+        fragments.x[fragments.count] = static_cast<uint32_t>(x);
+        if constexpr (Interp == Interpolation::Perspective) {
+            const float w = 1.f / (inv_w[0] * a + inv_w[1] * b + inv_w[2] * c);
+            fragments.u[fragments.count] = (u[0] * a + u[1] * b + u[2] * c) * w;
+            fragments.v[fragments.count] = (v[0] * a + v[1] * b + v[2] * c) * w;
+        } else {
+            fragments.u[fragments.count] = u[0] * a + u[1] * b + u[2] * c;
+            fragments.v[fragments.count] = v[0] * a + v[1] * b + v[2] * c;
+        }
+        fragments.count++;
+    }
+}
+
+template <TextureWrap Wrap>
+uint32_t get_texel_coordinate(float t, uint32_t size) {
+    const auto coordinate = static_cast<int64_t>(t * size);
+    if constexpr (Wrap == TextureWrap::Repeat) {
+        const auto wrapped = static_cast<uint32_t>(coordinate);
+        return wrapped >= size ? wrapped % size : wrapped;
+    } else {
+        return static_cast<uint32_t>(std::clamp<int64_t>(coordinate, 0, size - 1));
+    }
+}
+
+template <BlendMode Blend>
+uint32_t blend(uint32_t source, uint32_t destination) {
+    if constexpr (Blend == BlendMode::Opaque) {
+        return source | 0xff000000;
+    } else {
+        const uint32_t alpha = source >> 24;
+        uint32_t result = 0xff000000;
+        for (uint32_t shift = 0; shift < 24; shift += 8) {
+            const uint32_t s = (source >> shift) & 0xff;
+            const uint32_t d = (destination >> shift) & 0xff;
+            uint32_t channel;
+            if constexpr (Blend == BlendMode::Alpha) {
+                channel = (s * alpha + d * (255 - alpha) + 127) / 255;
+            } else {
+                channel = std::min<uint32_t>(s + d, 255);
+            }
+            result |= channel << shift;
+        }
+        return result;
+    }
+}
+
+template <TextureWrap Wrap, BlendMode Blend>
+void shade(const Texture& texture, const SpanFragments& fragments, uint32_t* buffer_row) {
+    for (uint32_t i = 0; i < fragments.count; i++) {
+        const uint32_t x = get_texel_coordinate<Wrap>(fragments.u[i], texture.width);
+        const uint32_t y = get_texel_coordinate<Wrap>(fragments.v[i], texture.height);
+        uint32_t& pixel = buffer_row[fragments.x[i]];
+        pixel = blend<Blend>(texture.texels[y * texture.width + x], pixel);
+    }
+}
+
+template <DepthMode Depth, TextureWrap Wrap, BlendMode Blend, Interpolation Interp>
+uint32_t draw_span_pipeline(const Kernels& kernels, const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, uint32_t* buffer_row, float* zbuffer_row, const Texture& texture, SpanFragments& fragments) {
+    if constexpr (Depth == DepthMode::TestAndWrite && Interp == Interpolation::Affine) {
+        kernels.draw_span(triangle, x1, x2, y, zbuffer_row, fragments);
+    } else {
+        draw_span<Depth, Interp>(triangle, x1, x2, y, zbuffer_row, fragments);
+    }
+
+    if constexpr (Wrap == TextureWrap::Repeat && Blend == BlendMode::Opaque) {
+        kernels.sample(texture, fragments, buffer_row);
+    } else {
+        shade<Wrap, Blend>(texture, fragments, buffer_row);
+    }
+    return fragments.count;
+}
+
+constexpr size_t get_pipeline_index(DepthMode depth_mode, TextureWrap texture_wrap, BlendMode blend_mode, Interpolation interpolation) {
+    return ((static_cast<size_t>(depth_mode) * TEXTURE_WRAP_COUNT + static_cast<size_t>(texture_wrap)) * BLEND_MODE_COUNT
+            + static_cast<size_t>(blend_mode)) * INTERPOLATION_COUNT + static_cast<size_t>(interpolation);
+}
+
+template <size_t Index>
+constexpr SpanPipeline make_span_pipeline() {
+    constexpr auto interpolation = static_cast<Interpolation>(Index % INTERPOLATION_COUNT);
+    constexpr auto blend_mode = static_cast<BlendMode>(Index / INTERPOLATION_COUNT % BLEND_MODE_COUNT);
+    constexpr auto texture_wrap = static_cast<TextureWrap>(Index / INTERPOLATION_COUNT / BLEND_MODE_COUNT % TEXTURE_WRAP_COUNT);
+    constexpr auto depth_mode = static_cast<DepthMode>(Index / INTERPOLATION_COUNT / BLEND_MODE_COUNT / TEXTURE_WRAP_COUNT);
+    static_assert(get_pipeline_index(depth_mode, texture_wrap, blend_mode, interpolation) == Index);
+    return draw_span_pipeline<depth_mode, texture_wrap, blend_mode, interpolation>;
+}
+
+template <size_t... Indices>
+constexpr std::array<SpanPipeline, sizeof...(Indices)> make_span_pipelines(std::index_sequence<Indices...>) {
+    return {make_span_pipeline<Indices>()...};
+}
+
+// One instantiation per combination of the state, indexed like get_pipeline_index
+constexpr std::array<SpanPipeline, PIPELINE_COUNT> SPAN_PIPELINES = make_span_pipelines(std::make_index_sequence<PIPELINE_COUNT>());
+}
+
+SpanPipeline get_span_pipeline(const PipelineState& state) {
+    return SPAN_PIPELINES[get_pipeline_index(state.depth_mode, state.texture_wrap, state.blend_mode, state.interpolation)];
+}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "kernels.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace renderer {
+enum class DepthMode : uint8_t {
+    // Fragments nearer than the depth buffer pass and replace it
+    TestAndWrite,
+    // Fragments nearer than the depth buffer pass and leave it untouched, for blended geometry over opaque one
+    Test,
+    // Every fragment passes and the depth buffer is left untouched
+    Off
+};
+
+enum class TextureWrap : uint8_t {
+    Repeat,
+    Clamp
+};
+
+enum class BlendMode : uint8_t {
+    Opaque,
+    // Blends by the alpha of the texel
+    Alpha,
+    // Adds the texel to the buffer, saturating every channel
+    Additive
+};
+
+enum class Interpolation : uint8_t {
+    // Linear in screen space, fast and exact for triangles facing the camera
+    Affine,
+    // Linear in view space, texture coordinates don't swim on triangles at an angle
+    Perspective
+};
+
+constexpr size_t DEPTH_MODE_COUNT = 3;
+constexpr size_t TEXTURE_WRAP_COUNT = 2;
+constexpr size_t BLEND_MODE_COUNT = 3;
+constexpr size_t INTERPOLATION_COUNT = 2;
+constexpr size_t PIPELINE_COUNT = DEPTH_MODE_COUNT * TEXTURE_WRAP_COUNT * BLEND_MODE_COUNT * INTERPOLATION_COUNT;
+
+struct PipelineState {
+    DepthMode depth_mode = DepthMode::TestAndWrite;
+    TextureWrap texture_wrap = TextureWrap::Repeat;
+    BlendMode blend_mode = BlendMode::Opaque;
+    Interpolation interpolation = Interpolation::Affine;
+};
+
+// Rasterizes the pixels x1 to x2 of row y, at most SPAN_CAPACITY of them, and returns how many were written.
+// fragments is scratch space for the span.
+using SpanPipeline = uint32_t (*)(const Kernels& kernels, const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, uint32_t* buffer_row, float* zbuffer_row, const Texture& texture, SpanFragments& fragments);
+
+// The loop specialized for the state, with every per-pixel decision resolved at compile time.
+// Stages the state leaves at their defaults go through the dispatched kernels.
+SpanPipeline get_span_pipeline(const PipelineState& state);
+}
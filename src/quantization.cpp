@@ -0,0 +1,61 @@
+#include "quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace renderer {
+namespace {
+constexpr float QUANTIZATION_RANGE = std::numeric_limits<uint16_t>::max();
+
+uint16_t quantize(float value, float offset, float scale) {
+    if (scale == 0.f) {
+        return 0;
+    }
+    const float quantized = std::round((value - offset) / scale);
+    return static_cast<uint16_t>(std::clamp(quantized, 0.f, QUANTIZATION_RANGE));
+}
+}
+
+Quantization create_quantization(const BoundingBox& bounding_box, const float uv_min[2], const float uv_max[2]) {
+    Quantization quantization = {};
+    for (size_t axis = 0; axis < 3; axis++) {
+        quantization.position_offset[axis] = bounding_box.min[axis];
+        quantization.position_scale[axis] = (bounding_box.max[axis] - bounding_box.min[axis]) / QUANTIZATION_RANGE;
+    }
+    for (size_t axis = 0; axis < 2; axis++) {
+        quantization.uv_offset[axis] = uv_min[axis];
+        quantization.uv_scale[axis] = (uv_max[axis] - uv_min[axis]) / QUANTIZATION_RANGE;
+    }
+    return quantization;
+}
+
+math::Matrix<4, 4> get_dequantization_matrix(const Quantization& quantization) {
+    math::Matrix<4, 4> mtx = math::create_translation_matrix(quantization.position_offset[0], quantization.position_offset[1], quantization.position_offset[2]);
+    mtx.data[0] = quantization.position_scale[0];
+    mtx.data[5] = quantization.position_scale[1];
+    mtx.data[10] = quantization.position_scale[2];
+    return mtx;
+}
+
+QuantizedVertex quantize_vertex(const Vertex& vertex, const Quantization& quantization) {
+    return QuantizedVertex {
+            quantize(vertex.x, quantization.position_offset[0], quantization.position_scale[0]),
+            quantize(vertex.y, quantization.position_offset[1], quantization.position_scale[1]),
+            quantize(vertex.z, quantization.position_offset[2], quantization.position_scale[2]),
+            quantize(vertex.u, quantization.uv_offset[0], quantization.uv_scale[0]),
+            quantize(vertex.v, quantization.uv_offset[1], quantization.uv_scale[1])
+    };
+}
+
+Vertex dequantize_vertex(const QuantizedVertex& vertex, const Quantization& quantization) {
+    return Vertex {
+            quantization.position_offset[0] + vertex.x * quantization.position_scale[0],
+            quantization.position_offset[1] + vertex.y * quantization.position_scale[1],
+            quantization.position_offset[2] + vertex.z * quantization.position_scale[2],
+            1.f,
+            quantization.uv_offset[0] + vertex.u * quantization.uv_scale[0],
+            quantization.uv_offset[1] + vertex.v * quantization.uv_scale[1]
+    };
+}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "frustum.h"
+#include "matrix.h"
+#include "vertex.h"
+
+#include <cstdint>
+
+namespace renderer {
+struct QuantizedVertex {
+    uint16_t x;
+    uint16_t y;
+    uint16_t z;
+    uint16_t u;
+    uint16_t v;
+};
+
+struct Quantization {
+    float position_offset[3];
+    float position_scale[3];
+    float uv_offset[2];
+    float uv_scale[2];
+};
+
+Quantization create_quantization(const BoundingBox& bounding_box, const float uv_min[2], const float uv_max[2]);
+// Positions are dequantized by this matrix, so it is meant to be folded into the model matrix
+math::Matrix<4, 4> get_dequantization_matrix(const Quantization& quantization);
+QuantizedVertex quantize_vertex(const Vertex& vertex, const Quantization& quantization);
+Vertex dequantize_vertex(const QuantizedVertex& vertex, const Quantization& quantization);
+
+// Keeps the position in the quantized space of the dequantization matrix and only dequantizes the texture coordinates
+inline Vertex unpack_vertex(const QuantizedVertex& vertex, const Quantization& quantization) {
+    return Vertex {
+            static_cast<float>(vertex.x),
+            static_cast<float>(vertex.y),
+            static_cast<float>(vertex.z),
+            1.f,
+            quantization.uv_offset[0] + vertex.u * quantization.uv_scale[0],
+            quantization.uv_offset[1] + vertex.v * quantization.uv_scale[1]
+    };
+}
+
+inline const Vertex& unpack_vertex(const Vertex& vertex, const Quantization& quantization) {
+    return vertex;
+}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "kernels.h"
+#include "render_target.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace renderer {
+// The positions of the vertices in the order the rasterizer walks them, from the top of the screen
+inline std::array<uint32_t, 3> sort_triangle(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3) {
+    const Vertex* vertices[3] = {&vertex1, &vertex2, &vertex3};
+    std::array<uint32_t, 3> order = {0, 1, 2};
+    if (vertices[order[2]]->y < vertices[order[0]]->y) {
+        std::swap(order[2], order[0]);
+    }
+    if (vertices[order[1]]->y < vertices[order[0]]->y) {
+        std::swap(order[1], order[0]);
+    }
+    if (vertices[order[2]]->y < vertices[order[1]]->y) {
+        std::swap(order[2], order[1]);
+    }
+    return order;
+}
+
+// The vertices have to be sorted by sort_triangle
+inline ScreenTriangle make_screen_triangle(const Vertex& v1, const Vertex& v2, const Vertex& v3, uint16_t width, uint16_t height) {
+    assert(v1.y <= v2.y);
+    assert(v2.y <= v3.y);
+
+    float barycentric_denom = (v2.x * width - v1.x * width) * (v3.y * height - v1.y * height) - (v3.x * width - v1.x * width) * (v2.y * height - v1.y * height);
+    if (barycentric_denom == 0.f) {
+        barycentric_denom = std::numeric_limits<float>::max();
+    }
+
+    return ScreenTriangle {
+            {v1.x * width, v2.x * width, v3.x * width},
+            {v1.y * height, v2.y * height, v3.y * height},
+            {v1.z, v2.z, v3.z},
+            {v1.u, v2.u, v3.u},
+            {v1.v, v2.v, v3.v},
+            {1.f / v1.w, 1.f / v2.w, 1.f / v3.w},
+            barycentric_denom
+    };
+}
+
+inline void get_barycentric_coords(const ScreenTriangle& triangle, float px, float py, float& a, float& b, float& c) {
+    const float* tx = triangle.x;
+    const float* ty = triangle.y;
+    a = ((tx[1] - px) * (ty[2] - py) - (tx[2] - px) * (ty[1] - py)) / triangle.barycentric_denom;
+    b = ((tx[2] - px) * (ty[0] - py) - (tx[0] - px) * (ty[2] - py)) / triangle.barycentric_denom;
+    c = 1.f - a - b;
+}
+
+// Calls draw_line(x1, x2, y) for every row of the triangle on the screen, with x1 <= x2 clamped to the screen
+// The pixels of a span passed to the line function of walk_triangle
+inline Rect get_span_rect(int64_t x1, int64_t x2, int64_t y) {
+    return Rect {static_cast<uint16_t>(x1), static_cast<uint16_t>(y), static_cast<uint16_t>(x2 + 1), static_cast<uint16_t>(y + 1)};
+}
+
+template <typename LineFunction>
+void walk_triangle(const ScreenTriangle& triangle, uint16_t width, uint16_t height, LineFunction&& draw_line) {
+    auto draw_clamped_line = [&](int64_t x1, int64_t x2, int64_t y) {
+        if (x2 < x1) {
+            std::swap(x1, x2);
+        }
+        x1 = std::max<int64_t>(x1, 0);
+        x2 = std::min(x2, static_cast<int64_t>(width - 1));
+        if (x1 <= x2) {
+            draw_line(x1, x2, y);
+        }
+    };
+
+    float x1 = triangle.x[0];
+    int64_t y1 = triangle.y[0];
+    float x2 = triangle.x[1];
+    int64_t y2 = triangle.y[1];
+    float x3 = triangle.x[2];
+    int64_t y3 = triangle.y[2];
+
+    if (y1 >= height || y3 < 0) {
+        return;
+    }
+
+    const uint64_t dy_ab = y2 - y1;
+    const uint64_t dy_bc = y3 - y2;
+    const uint64_t dy_ac = y3 - y1;
+
+    if (dy_ab > 0) {
+        const float dx_ab = (x2 - x1) / dy_ab;
+        const float dx_ac = (x3 - x1) / dy_ac;
+
+        int64_t i = 0;
+        do {
+            int64_t y = y1 + i;
+            if (y < 0) {
+                continue;
+            }
+            if (y >= height) {
+                break;
+            }
+
+            int64_t x_start = (x1 + dx_ab * i);
+            int64_t x_end = (x1 + dx_ac * i);
+            draw_clamped_line(x_start, x_end, y);
+        } while (++i < dy_ab);
+    }
+
+    const float mx = x1 + dy_ab * (x3 - x1) / dy_ac;
+    const float dx_bc = (x3 - x2) / dy_bc;
+    const float dx_ec = (x3 - mx) / dy_bc;
+
+    int64_t i = 0;
+    do {
+        int64_t y = y2 + i;
+        if (y < 0) {
+            continue;
+        }
+        if (y >= height) {
+            break;
+        }
+
+        int64_t x_start = (x2 + dx_bc * i);
+        int64_t x_end = (mx + dx_ec * i);
+        draw_clamped_line(x_start, x_end, y);
+    } while (++i <= dy_bc);
+}
+}
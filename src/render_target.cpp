@@ -0,0 +1,117 @@
+#include "render_target.h"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+namespace renderer {
+RenderTarget::RenderTarget(uint16_t width, uint16_t height, PixelFormat format) : format(format) {
+    resize(width, height);
+}
+
+void RenderTarget::attach_color_buffer(uint32_t* pixels) {
+    attached_color_buffer = pixels;
+    cleared = false;
+    if (pixels != nullptr) {
+        color_buffer = {};
+    } else {
+        color_buffer.resize(stride * height);
+    }
+}
+
+void RenderTarget::copy_to(void* pixels, size_t pitch) const {
+    auto destination = static_cast<uint8_t*>(pixels);
+    for (size_t y = 0; y < height; y++) {
+        std::memcpy(destination + y * pitch, get_color_row(y), width * sizeof(uint32_t));
+    }
+}
+
+uint32_t* RenderTarget::get_color_buffer() {
+    return attached_color_buffer != nullptr ? attached_color_buffer : color_buffer.data();
+}
+
+const uint32_t* RenderTarget::get_color_buffer() const {
+    return attached_color_buffer != nullptr ? attached_color_buffer : color_buffer.data();
+}
+
+uint32_t* RenderTarget::get_color_row(size_t y) {
+    return get_color_buffer() + stride * y;
+}
+
+const uint32_t* RenderTarget::get_color_row(size_t y) const {
+    return get_color_buffer() + stride * y;
+}
+
+float* RenderTarget::get_depth_buffer() {
+    return depth_buffer.data();
+}
+
+float* RenderTarget::get_depth_row(size_t y) {
+    return depth_buffer.data() + stride * y;
+}
+
+const Rect& RenderTarget::get_dirty_rect() const {
+    return dirty_rect;
+}
+
+PixelFormat RenderTarget::get_format() const {
+    return format;
+}
+
+uint16_t RenderTarget::get_height() const {
+    return height;
+}
+
+size_t RenderTarget::get_pitch() const {
+    return stride * sizeof(uint32_t);
+}
+
+size_t RenderTarget::get_pixel_count() const {
+    return stride * height;
+}
+
+size_t RenderTarget::get_stride() const {
+    return stride;
+}
+
+uint16_t RenderTarget::get_width() const {
+    return width;
+}
+
+bool RenderTarget::is_clean_outside_dirty_rect(uint32_t clear_color) const {
+    return cleared && this->clear_color == clear_color;
+}
+
+void RenderTarget::mark_all_dirty() {
+    dirty_rect = Rect {0, 0, width, height};
+}
+
+void RenderTarget::mark_cleared(uint32_t clear_color, bool full) {
+    this->clear_color = clear_color;
+    cleared = true;
+    if (full) {
+        mark_all_dirty();
+    } else {
+        dirty_rect = Rect {};
+    }
+}
+
+void RenderTarget::mark_dirty(const Rect& rect) {
+    dirty_rect.expand(rect);
+}
+
+void RenderTarget::resize(uint16_t width, uint16_t height) {
+    assert(attached_color_buffer == nullptr);
+    this->width = width;
+    this->height = height;
+    stride = get_stride(width);
+    cleared = false;
+    color_buffer.resize(stride * height);
+    depth_buffer.resize(stride * height, std::numeric_limits<float>::max());
+}
+
+size_t RenderTarget::get_stride(uint16_t width) {
+    constexpr size_t pixels_per_line = RENDER_TARGET_ALIGNMENT / sizeof(uint32_t);
+    return (static_cast<size_t>(width) + pixels_per_line - 1) / pixels_per_line * pixels_per_line;
+}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace renderer {
+// Rows of both buffers start on a cache line, so the span kernels never split a vector load across two of them
+constexpr size_t RENDER_TARGET_ALIGNMENT = 64;
+
+// The layout of the color buffer, the rasterizer and the model textures work in 32-bit BGRA
+enum class PixelFormat : uint8_t {
+    BGRA8888
+};
+
+// A rectangle of pixels, x2 and y2 are exclusive
+struct Rect {
+    uint16_t x1;
+    uint16_t y1;
+    uint16_t x2;
+    uint16_t y2;
+
+    bool is_empty() const {
+        return x1 >= x2 || y1 >= y2;
+    }
+
+    void expand(const Rect& rect) {
+        if (rect.is_empty()) {
+            return;
+        }
+        if (is_empty()) {
+            *this = rect;
+            return;
+        }
+        x1 = std::min(x1, rect.x1);
+        y1 = std::min(y1, rect.y1);
+        x2 = std::max(x2, rect.x2);
+        y2 = std::max(y2, rect.y2);
+    }
+};
+
+template <typename T, size_t Alignment>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* pointer, size_t) {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    bool operator==(const AlignedAllocator&) const {
+        return true;
+    }
+
+    bool operator!=(const AlignedAllocator&) const {
+        return false;
+    }
+};
+
+// An offscreen color and depth buffer pair. Both have the same stride, in pixels, which pads every row to
+// RENDER_TARGET_ALIGNMENT. Any number of targets can be drawn by the same renderer, presenting one is up to the caller.
+class RenderTarget {
+public:
+    RenderTarget(uint16_t width, uint16_t height, PixelFormat format = PixelFormat::BGRA8888);
+    // Renders into get_pixel_count pixels of external memory from now on, such as shared memory mapped by another
+    // process, instead of the owned color buffer. nullptr goes back to an owned one. The depth buffer stays owned.
+    void attach_color_buffer(uint32_t* pixels);
+    // Copies the visible pixels into a buffer of the same format with the given pitch in bytes
+    void copy_to(void* pixels, size_t pitch) const;
+    // The pixels that may differ from the clear color since the last clear, the whole target after a full clear,
+    // since the previous contents are unknown
+    const Rect& get_dirty_rect() const;
+    // Whether the target was cleared to the color and only the dirty rect was written since
+    bool is_clean_outside_dirty_rect(uint32_t clear_color) const;
+    // Called by whatever writes the color or depth buffer
+    void mark_dirty(const Rect& rect);
+    void mark_all_dirty();
+    // Called after the dirty rect, or the whole target when full, was cleared to the color
+    void mark_cleared(uint32_t clear_color, bool full);
+    uint32_t* get_color_buffer();
+    const uint32_t* get_color_buffer() const;
+    uint32_t* get_color_row(size_t y);
+    const uint32_t* get_color_row(size_t y) const;
+    float* get_depth_buffer();
+    float* get_depth_row(size_t y);
+    PixelFormat get_format() const;
+    uint16_t get_height() const;
+    // Pitch of a color row in bytes
+    size_t get_pitch() const;
+    size_t get_pixel_count() const;
+    size_t get_stride() const;
+    uint16_t get_width() const;
+    // The contents are undefined until the next clear. An attached color buffer has to be detached first.
+    void resize(uint16_t width, uint16_t height);
+
+    // The stride of every target of the given width
+    static size_t get_stride(uint16_t width);
+private:
+    uint32_t* attached_color_buffer = nullptr;
+    uint32_t clear_color = 0;
+    bool cleared = false;
+    std::vector<uint32_t, AlignedAllocator<uint32_t, RENDER_TARGET_ALIGNMENT>> color_buffer;
+    std::vector<float, AlignedAllocator<float, RENDER_TARGET_ALIGNMENT>> depth_buffer;
+    Rect dirty_rect {};
+    PixelFormat format;
+    uint16_t height = 0;
+    size_t stride = 0;
+    uint16_t width = 0;
+};
+}
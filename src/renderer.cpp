@@ -1,183 +1,528 @@
+#include "command_list.h"
+#include "frustum.h"
 #include "matrix.h"
 #include "model.h"
+#include "quantization.h"
+#include "rasterizer.h"
 #include "renderer.h"
 #include "vertex.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
-#include <SDL2/SDL_video.h>
+#include <type_traits>
 
 namespace renderer {
-Renderer::Renderer(const SDL_Window* window, uint16_t width, uint16_t height, Color clear_color)
-        : window(window), width(width), height(height), clear_color(clear_color) {
-    zbuffer.resize(width * height, std::numeric_limits<float>::max());
+namespace {
+// Counts of 1 to 8 go from blue through green and yellow to red, everything above is white
+Color get_heat_color(uint16_t count) {
+    constexpr Color HEAT_COLORS[] = {
+            {255, 0, 0, 255},
+            {255, 128, 0, 255},
+            {128, 255, 0, 255},
+            {0, 255, 0, 255},
+            {0, 255, 255, 255},
+            {0, 192, 255, 255},
+            {0, 128, 255, 255},
+            {0, 0, 255, 255},
+            {255, 255, 255, 255}
+    };
+    constexpr size_t HEAT_COLOR_COUNT = sizeof(HEAT_COLORS) / sizeof(HEAT_COLORS[0]);
+    return HEAT_COLORS[std::min<size_t>(count, HEAT_COLOR_COUNT) - 1];
 }
 
-void Renderer::clear_buffer(uint32_t* buffer) {
-    std::fill(buffer, buffer + width * height, clear_color.bgra);
-    std::fill(zbuffer.begin(), zbuffer.end(), std::numeric_limits<float>::max());
+// Makes room for count more elements, growing by at least half of the capacity, so that the storage settles after
+// a few frames instead of growing by a little every time the view brings more triangles into sight
+template <typename T>
+void reserve_more(std::vector<T>& vector, size_t count) {
+    if (vector.size() + count > vector.capacity()) {
+        vector.reserve(std::max(vector.size() + count, vector.capacity() + vector.capacity() / 2));
+    }
+}
+
+void add_geometry_stats(Stats& stats, const Stats& geometry_stats) {
+    stats.meshlets_culled += geometry_stats.meshlets_culled;
+    stats.meshlets_drawn += geometry_stats.meshlets_drawn;
+    stats.models_culled += geometry_stats.models_culled;
+    stats.triangles_culled += geometry_stats.triangles_culled;
+    stats.triangles_drawn += geometry_stats.triangles_drawn;
+    stats.vertices_transformed += geometry_stats.vertices_transformed;
+}
+}
+
+Renderer::Renderer(Color clear_color)
+        : clear_color(clear_color), kernels(get_kernels()), span_pipeline(get_span_pipeline(pipeline_state)) {
+}
+
+void Renderer::begin_geometry(FrameGeometry& geometry, uint16_t width, uint16_t height) {
+    geometry.bins.clear();
+    geometry.height = height;
+    geometry.indices.clear();
+    geometry.stats = Stats {};
+    geometry.vertices.clear();
+    geometry.width = width;
+    this->geometry = &geometry;
 }
 
-void Renderer::draw_model(const Model* model, uint32_t* buffer, const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov) {
-    const math::Matrix mtx = get_transform_matrix(rotation_mtx, translation_mtx, fov);
-    const std::vector<Vertex>& vertex_buffer = model->get_vertex_buffer();
-    for (size_t i = 0; i < vertex_buffer.size(); i += 3) {
-        Vertex vertex1 = transform_vertex(vertex_buffer[i], mtx);
-        Vertex vertex2 = transform_vertex(vertex_buffer[i + 1], mtx);
-        Vertex vertex3 = transform_vertex(vertex_buffer[i + 2], mtx);
+void Renderer::begin_transform(size_t vertex_count) {
+    if (transformed_vertices.size() < vertex_count) {
+        pending_vertices.reserve(vertex_count);
+        transformed_vertices.resize(vertex_count);
+        transform_stamps.resize(vertex_count, 0);
+        vertex_remap.resize(vertex_count);
+    }
+
+    // Bumping the stamp invalidates every cached vertex of the previous draw without touching them
+    transform_stamp++;
+    if (transform_stamp == 0) {
+        std::fill(transform_stamps.begin(), transform_stamps.end(), 0);
+        transform_stamp = 1;
+    }
+}
 
-        if (vertex3.y < vertex1.y) {
-            std::swap(vertex3, vertex1);
+void Renderer::bind_target(const RenderTarget& target) {
+    width = target.get_width();
+    height = target.get_height();
+    if (debug_view != DebugView::None && coverage_counts.size() != target.get_pixel_count()) {
+        coverage_counts.assign(target.get_pixel_count(), 0);
+        depth_pass_counts.assign(target.get_pixel_count(), 0);
+    }
+}
+
+void Renderer::clear(RenderTarget& target, Color color) {
+    // When the target holds a frame cleared to the same color, only the pixels drawn since differ from it
+    const bool full = !target.is_clean_outside_dirty_rect(color.bgra);
+    if (full) {
+        kernels.clear(target.get_color_buffer(), target.get_depth_buffer(), target.get_pixel_count(), color.bgra, std::numeric_limits<float>::max());
+        stats.pixels_cleared += target.get_pixel_count();
+    } else {
+        const Rect& rect = target.get_dirty_rect();
+        const size_t rect_width = rect.x2 - rect.x1;
+        for (size_t y = rect.y1; y < rect.y2; y++) {
+            kernels.clear(target.get_color_row(y) + rect.x1, target.get_depth_row(y) + rect.x1, rect_width, color.bgra, std::numeric_limits<float>::max());
         }
-        if (vertex2.y < vertex1.y) {
-            std::swap(vertex2, vertex1);
+        stats.pixels_cleared += rect.is_empty() ? 0 : rect_width * (rect.y2 - rect.y1);
+    }
+    target.mark_cleared(color.bgra, full);
+    if (debug_view != DebugView::None) {
+        std::fill(coverage_counts.begin(), coverage_counts.end(), 0);
+        std::fill(depth_pass_counts.begin(), depth_pass_counts.end(), 0);
+    }
+}
+
+void Renderer::clear_buffer(RenderTarget& target) {
+    bind_target(target);
+    clear(target, clear_color);
+}
+
+void Renderer::draw_model(const Model* model, RenderTarget& target, const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov) {
+    const math::Matrix<4, 4> model_mtx = math::mul(translation_mtx, rotation_mtx);
+    draw_model_instanced(model, target, &model_mtx, 1, fov);
+}
+
+void Renderer::draw_model_instanced(const Model* model, RenderTarget& target, const math::Matrix<4, 4>* model_matrices, size_t instance_count, float fov) {
+    begin_geometry(immediate_geometry, target.get_width(), target.get_height());
+    cull_instances(model, model_matrices, instance_count, fov);
+    bin_visible_instances();
+    geometry = nullptr;
+    rasterize(immediate_geometry, target);
+}
+
+void Renderer::cull_instances(const Model* model, const math::Matrix<4, 4>* model_matrices, size_t instance_count, float fov) {
+    const math::Matrix<4, 4> projection_mtx = get_projection_matrix(fov, geometry->width, geometry->height);
+
+    // The bounding sphere is culled in view space against a frustum shared by all instances
+    const Frustum view_frustum(projection_mtx);
+    const BoundingSphere& sphere = model->get_bounding_sphere();
+    const math::Vector<4> center = {sphere.x, sphere.y, sphere.z, 1.f};
+
+    for (size_t i = 0; i < instance_count; i++) {
+        const math::Matrix<4, 4>& model_mtx = model_matrices[i];
+        const math::Vector<4> view_center = math::mul(model_mtx, center);
+        const BoundingSphere view_sphere = {view_center.data[0], view_center.data[1], view_center.data[2], sphere.radius * get_max_scale(model_mtx)};
+
+        const math::Matrix<4, 4> mtx = math::mul(projection_mtx, model_mtx);
+        Visibility visibility = view_frustum.classify(view_sphere);
+        if (visibility == Visibility::Intersecting) {
+            visibility = Frustum(mtx).classify(model->get_bounding_box());
         }
-        if (vertex3.y < vertex2.y) {
-            std::swap(vertex3, vertex2);
+        if (visibility == Visibility::Outside) {
+            geometry->stats.models_culled++;
+            geometry->stats.triangles_culled += model->get_lods()[0].index_buffer.size() / 3;
+            continue;
         }
-
-        draw_triangle(vertex1, vertex2, vertex3, buffer, model->get_texture());
+        visible_instances.push_back(VisibleInstance {model, mtx, visibility, view_sphere.z, view_sphere.radius, 0});
     }
 }
 
-inline math::Matrix<4, 4> Renderer::get_transform_matrix(const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov) const {
-    math::Matrix<4, 4> mtx = math::mul(translation_mtx, rotation_mtx);
-    math::Matrix proj = math::create_projection_matrix(width, height, 0.01f, 100.f, fov);
-    mtx = math::mul(proj, mtx);
-    return mtx;
+void Renderer::bin_visible_instances() {
+    // The storage of the frame is reserved up front for every visible instance, at most a vertex per index
+    size_t index_count = 0;
+    size_t max_index_count = 0;
+    size_t vertex_count = 0;
+    instance_order.resize(visible_instances.size());
+    for (size_t i = 0; i < visible_instances.size(); i++) {
+        VisibleInstance& instance = visible_instances[i];
+        instance.lod = select_lod(instance.model, instance.mtx);
+        const size_t lod_index_count = instance.model->get_lods()[instance.lod].index_buffer.size();
+        index_count += lod_index_count;
+        max_index_count = std::max(max_index_count, lod_index_count);
+        vertex_count += std::min(instance.model->get_vertex_count(), lod_index_count);
+        instance_order[i] = static_cast<uint32_t>(i);
+    }
+    reserve_more(geometry->bins, visible_instances.size());
+    reserve_more(geometry->indices, index_count);
+    reserve_more(geometry->vertices, vertex_count);
+    if (depth_sort == DepthSort::DrawsAndTriangles) {
+        reserve_more(queued_triangles, max_index_count / 3);
+    }
+
+    // Drawing the nearest bounds first lets the depth test reject the hidden pixels before they are textured.
+    // Ties keep their order. The indices are sorted because stable sorting the instances would allocate.
+    if (depth_sort != DepthSort::None) {
+        std::sort(instance_order.begin(), instance_order.end(), [this](uint32_t l, uint32_t r) {
+            const float l_depth = visible_instances[l].depth - visible_instances[l].radius;
+            const float r_depth = visible_instances[r].depth - visible_instances[r].radius;
+            return l_depth < r_depth || (l_depth == r_depth && l < r);
+        });
+    }
+
+    for (uint32_t index : instance_order) {
+        draw_instance(visible_instances[index]);
+    }
+    visible_instances.clear();
 }
 
-inline Vertex Renderer::transform_vertex(const Vertex &vertex, const math::Matrix<4, 4>& matrix) const {
-    const math::Vector<4> vector = math::mul(matrix, vertex.xyzw);
-    assert(vector.data[3] != 0.f);
-    Vertex vertex_out = vertex;
-    vertex_out.x = (vector.data[0] / vector.data[3] + 1.f) / 2.f;
-    vertex_out.y = (vector.data[1] / vector.data[3] + 1.f) / 2.f;
-    vertex_out.z = vector.data[2] / vector.data[3];
-    return vertex_out;
+void Renderer::draw_instance(const VisibleInstance& instance) {
+    const Model* model = instance.model;
+    const math::Matrix<4, 4>& mtx = instance.mtx;
+    const Lod& lod = model->get_lods()[instance.lod];
+    const auto first_index = static_cast<uint32_t>(geometry->indices.size());
+
+    math::Matrix<4, 4> vertex_mtx = mtx;
+    if (model->is_quantized()) {
+        vertex_mtx = math::mul(mtx, get_dequantization_matrix(model->get_quantization()));
+    }
+
+    begin_transform(model->get_vertex_count());
+
+    if (lod.meshlets.empty()) {
+        draw_triangles(instance, lod.index_buffer, vertex_mtx, 0, lod.index_buffer.size(), instance.visibility);
+    } else {
+        const Frustum frustum(mtx);
+        float eye[3];
+        const bool has_eye = get_eye_position(mtx, eye);
+        for (const Meshlet& meshlet : lod.meshlets) {
+            Visibility meshlet_visibility = instance.visibility;
+            if (instance.visibility == Visibility::Intersecting) {
+                meshlet_visibility = frustum.classify(meshlet.bounding_sphere);
+            }
+            if (meshlet_visibility == Visibility::Outside || (has_eye && is_backfacing(meshlet, eye))) {
+                geometry->stats.meshlets_culled++;
+                geometry->stats.triangles_culled += meshlet.index_count / 3;
+                continue;
+            }
+
+            geometry->stats.meshlets_drawn++;
+            draw_triangles(instance, lod.index_buffer, vertex_mtx, meshlet.first_index, meshlet.index_count, meshlet_visibility);
+        }
+    }
+
+    if (depth_sort == DepthSort::DrawsAndTriangles) {
+        bin_queued_triangles();
+    }
+
+    const auto index_count = static_cast<uint32_t>(geometry->indices.size() - first_index);
+    if (index_count > 0) {
+        geometry->bins.push_back(GeometryBin {false, clear_color, pipeline_state, model->get_texels(), first_index, index_count});
+    }
 }
 
-void Renderer::draw_triangle(const Vertex &v1, const Vertex &v2, const Vertex &v3, uint32_t* buffer, const SDL_Surface* texture) {
-    assert(v1.y <= v2.y);
-    assert(v2.y <= v3.y);
+void Renderer::bin_queued_triangles() {
+    // Counting sort by depth bucket, triangles inside a bucket keep their order
+    size_t bucket_offsets[DEPTH_BUCKETS + 1] = {};
+    for (const QueuedTriangle& triangle : queued_triangles) {
+        bucket_offsets[triangle.bucket + 1]++;
+    }
+    for (size_t bucket = 0; bucket < DEPTH_BUCKETS; bucket++) {
+        bucket_offsets[bucket + 1] += bucket_offsets[bucket];
+    }
 
-    float barycentric_denom = (v2.x * width - v1.x * width) * (v3.y * height - v1.y * height) - (v3.x * width - v1.x * width) * (v2.y * height - v1.y * height);
-    if (barycentric_denom == 0.f) {
-        barycentric_denom = std::numeric_limits<float>::max();
+    sorted_triangles.resize(queued_triangles.size());
+    for (const QueuedTriangle& triangle : queued_triangles) {
+        sorted_triangles[bucket_offsets[triangle.bucket]++] = triangle;
     }
+    queued_triangles.clear();
 
-    float x1 = v1.x * width;
-    int64_t y1 = v1.y * height;
-    float x2 = v2.x * width;
-    int64_t y2 = v2.y * height;
-    float x3 = v3.x * width;
-    int64_t y3 = v3.y * height;
+    for (const QueuedTriangle& triangle : sorted_triangles) {
+        geometry->indices.insert(geometry->indices.end(), {triangle.index1, triangle.index2, triangle.index3});
+    }
+}
 
-    if (y1 >= height || y3 < 0) {
-        return;
+void Renderer::draw_triangles(const VisibleInstance& instance, const std::vector<uint32_t>& index_buffer, const math::Matrix<4, 4>& mtx, size_t first_index, size_t index_count, Visibility visibility) {
+    const Model* model = instance.model;
+    if (model->is_quantized()) {
+        draw_triangles(instance, index_buffer, model->get_quantized_vertex_buffer(), mtx, first_index, index_count, visibility);
+    } else {
+        draw_triangles(instance, index_buffer, model->get_vertex_buffer(), mtx, first_index, index_count, visibility);
     }
+}
+
+template <typename VertexType>
+void Renderer::draw_triangles(const VisibleInstance& instance, const std::vector<uint32_t>& index_buffer, const std::vector<VertexType>& vertex_buffer, const math::Matrix<4, 4>& mtx, size_t first_index, size_t index_count, Visibility visibility) {
+    const float bucket_scale = instance.radius > 0.f ? DEPTH_BUCKETS / (2.f * instance.radius) : 0.f;
+    const float bucket_offset = instance.depth - instance.radius;
+
+    transform_vertices(index_buffer, vertex_buffer, instance.model->get_quantization(), mtx, first_index, index_count);
 
-    const uint64_t dy_ab = y2 - y1;
-    const uint64_t dy_bc = y3 - y2;
-    const uint64_t dy_ac = y3 - y1;
+    for (size_t i = first_index; i < first_index + index_count; i += 3) {
+        const uint32_t index1 = index_buffer[i];
+        const uint32_t index2 = index_buffer[i + 1];
+        const uint32_t index3 = index_buffer[i + 2];
+        const TransformedVertex& transformed1 = transformed_vertices[index1];
+        const TransformedVertex& transformed2 = transformed_vertices[index2];
+        const TransformedVertex& transformed3 = transformed_vertices[index3];
 
-    if (dy_ab > 0) {
-        const float dx_ab = (x2 - x1) / dy_ab;
-        const float dx_ac = (x3 - x1) / dy_ac;
+        if (visibility != Visibility::Inside) {
+            const uint8_t code1 = transformed1.clip_code;
+            const uint8_t code2 = transformed2.clip_code;
+            const uint8_t code3 = transformed3.clip_code;
 
-        int64_t i = 0;
-        do {
-            int64_t y = y1 + i;
-            if (y < 0) {
+            // Triangles crossing the near plane can't be projected, so they are rejected along with the invisible ones
+            if ((code1 & code2 & code3) != 0 || ((code1 | code2 | code3) & CLIP_NEAR) != 0) {
+                geometry->stats.triangles_culled++;
                 continue;
             }
-            if (y >= height) {
-                break;
-            }
+        }
 
-            int64_t x_start = (x1 + dx_ab * i);
-            int64_t x_end = (x1 + dx_ac * i);
-            draw_line(v1, v2, v3, barycentric_denom, x_start, x_end, y, buffer, texture);
-        } while (++i < dy_ab);
+        geometry->stats.triangles_drawn++;
+
+        if (depth_sort == DepthSort::DrawsAndTriangles) {
+            const float depth = (transformed1.vertex.w + transformed2.vertex.w + transformed3.vertex.w) / 3.f;
+            const float bucket = std::clamp((depth - bucket_offset) * bucket_scale, 0.f, static_cast<float>(DEPTH_BUCKETS - 1));
+            queued_triangles.push_back(QueuedTriangle {vertex_remap[index1], vertex_remap[index2], vertex_remap[index3], static_cast<uint32_t>(bucket)});
+            continue;
+        }
+
+        geometry->indices.insert(geometry->indices.end(), {vertex_remap[index1], vertex_remap[index2], vertex_remap[index3]});
     }
+}
 
-    const float mx = x1 + dy_ab * (x3 - x1) / dy_ac;
-    const float dx_bc = (x3 - x2) / dy_bc;
-    const float dx_ec = (x3 - mx) / dy_bc;
+float Renderer::get_max_scale(const math::Matrix<4, 4>& mtx) const {
+    float scale_sq = 0.f;
+    for (size_t column = 0; column < 3; column++) {
+        const float x = mtx.data[column];
+        const float y = mtx.data[column + 4];
+        const float z = mtx.data[column + 8];
+        scale_sq = std::max(scale_sq, x * x + y * y + z * z);
+    }
+    return sqrtf(scale_sq);
+}
 
-    int64_t i = 0;
-    do {
-        int64_t y = y2 + i;
-        if (y < 0) {
-            continue;
+math::Matrix<4, 4> Renderer::get_projection_matrix(float fov, uint16_t width, uint16_t height) const {
+    return math::create_projection_matrix(width, height, 0.01f, 100.f, fov);
+}
+
+template <typename VertexType>
+void Renderer::transform_vertices(const std::vector<uint32_t>& index_buffer, const std::vector<VertexType>& vertex_buffer, const Quantization& quantization, const math::Matrix<4, 4>& mtx, size_t first_index, size_t index_count) {
+    // Only the vertices not transformed earlier in the draw are gathered, and then transformed in one batch
+    pending_vertices.clear();
+    for (size_t i = first_index; i < first_index + index_count; i++) {
+        const uint32_t index = index_buffer[i];
+        if (transform_stamps[index] != transform_stamp) {
+            transform_stamps[index] = transform_stamp;
+            pending_vertices.push_back(index);
+        }
+    }
+    geometry->stats.vertices_transformed += pending_vertices.size();
+
+    if constexpr (std::is_same_v<VertexType, Vertex>) {
+        kernels.transform(mtx, vertex_buffer.data(), pending_vertices.data(), pending_vertices.size(), transformed_vertices.data());
+    } else {
+        if (unpacked_vertices.size() < vertex_buffer.size()) {
+            unpacked_vertices.resize(vertex_buffer.size());
+        }
+        for (uint32_t index : pending_vertices) {
+            unpacked_vertices[index] = unpack_vertex(vertex_buffer[index], quantization);
+        }
+        kernels.transform(mtx, unpacked_vertices.data(), pending_vertices.data(), pending_vertices.size(), transformed_vertices.data());
+    }
+
+    // The projected ones are packed into the frame, the triangles refer to them through the remap
+    for (uint32_t index : pending_vertices) {
+        if ((transformed_vertices[index].clip_code & CLIP_NEAR) == 0) {
+            vertex_remap[index] = static_cast<uint32_t>(geometry->vertices.size());
+            geometry->vertices.push_back(transformed_vertices[index].vertex);
         }
-        if (y >= height) {
-            break;
+    }
+}
+
+void Renderer::draw_triangle(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, RenderTarget& target, const Texture& texture) {
+    const Vertex* vertices[3] = {&vertex1, &vertex2, &vertex3};
+    const std::array<uint32_t, 3> order = sort_triangle(vertex1, vertex2, vertex3);
+    const ScreenTriangle triangle = make_screen_triangle(*vertices[order[0]], *vertices[order[1]], *vertices[order[2]], width, height);
+    Rect bounds {};
+    walk_triangle(triangle, width, height, [&](int64_t x1, int64_t x2, int64_t y) {
+        bounds.expand(get_span_rect(x1, x2, y));
+        draw_line(triangle, x1, x2, y, target, texture);
+    });
+    target.mark_dirty(bounds);
+}
+
+inline void Renderer::draw_line(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, RenderTarget& target, const Texture& texture) {
+    stats.pixels_tested += x2 - x1 + 1;
+
+    if (debug_view != DebugView::None) {
+        for (int64_t x = x1; x <= x2; x++) {
+            draw_debug_pixel(triangle, x, y, target);
         }
+        return;
+    }
 
-        int64_t x_start = (x2 + dx_bc * i);
-        int64_t x_end = (mx + dx_ec * i);
-        draw_line(v1, v2, v3, barycentric_denom, x_start, x_end, y, buffer, texture);
-    } while (++i <= dy_bc);
+    uint32_t* buffer_row = target.get_color_row(y);
+    float* zbuffer_row = target.get_depth_row(y);
+    for (int64_t x = x1; x <= x2; x += SPAN_CAPACITY) {
+        stats.pixels_shaded += span_pipeline(kernels, triangle, x, std::min<int64_t>(x2, x + SPAN_CAPACITY - 1), y, buffer_row, zbuffer_row, texture, span_fragments);
+    }
 }
 
-inline void Renderer::draw_line(const Vertex& v1, const Vertex& v2, const Vertex& v3, float barycentric_denom, int64_t x1, int64_t x2, int64_t y, uint32_t* buffer, const SDL_Surface* texture) {
-    if (x2 < x1) {
-        std::swap(x1, x2);
+void Renderer::draw_debug_pixel(const ScreenTriangle& triangle, int64_t x, int64_t y, RenderTarget& target) {
+    const size_t idx = target.get_stride() * y + x;
+    span_fragments.count = 0;
+    draw_span_pixel(triangle, x, static_cast<float>(y), target.get_depth_row(y), span_fragments);
+    const bool passes_depth = span_fragments.count > 0;
+    if (passes_depth) {
+        stats.pixels_shaded++;
+    }
+
+    uint16_t& coverage = coverage_counts[idx];
+    uint16_t& depth_passes = depth_pass_counts[idx];
+    if (coverage == 0) {
+        stats.covered_pixels++;
+    }
+    coverage = std::min<uint16_t>(coverage + 1, std::numeric_limits<uint16_t>::max());
+    stats.max_coverage = std::max<uint64_t>(stats.max_coverage, coverage);
+
+    if (passes_depth) {
+        depth_passes = std::min<uint16_t>(depth_passes + 1, std::numeric_limits<uint16_t>::max());
+        stats.max_depth_passes = std::max<uint64_t>(stats.max_depth_passes, depth_passes);
     }
-    x1 = std::max<int64_t>(x1, 0);
-    x2 = std::min(x2, static_cast<int64_t>(width - 1));
-    while (x1 <= x2) {
-        draw_pixel(Pixel {x1, y}, v1, v2, v3, barycentric_denom, buffer, texture);
-        x1++;
+
+    const uint16_t count = debug_view == DebugView::Coverage ? coverage : depth_passes;
+    if (count > 0) {
+        target.get_color_buffer()[idx] = get_heat_color(count).bgra;
     }
 }
 
-void Renderer::draw_pixel(const Pixel& p, const Vertex& v1, const Vertex& v2, const Vertex& v3, float barycentric_denom, uint32_t* buffer, const SDL_Surface* texture) {
-    assert(p.x >= 0 && p.x < width && p.y >= 0 && p.y < height);
-    assert(buffer != nullptr);
-    assert(texture != nullptr);
-    size_t idx = width * p.y + p.x;
+const Stats& Renderer::get_stats() const {
+    return stats;
+}
+
+void Renderer::reset_stats() {
+    stats = Stats {};
+}
 
-    BarycentricPoint barycentric_point = get_barycentric_coords(p, v1, v2, v3, barycentric_denom);
-    const float z = v1.z * barycentric_point.a + v2.z * barycentric_point.b + v3.z * barycentric_point.c;
+size_t Renderer::select_lod(const Model* model, const math::Matrix<4, 4>& mtx) const {
+    const std::vector<Lod>& lods = model->get_lods();
+    if (lods.size() == 1 || lod_density <= 0.f) {
+        return 0;
+    }
 
-    if (z < zbuffer[idx]) {
-        const float uf = v1.u * barycentric_point.a + v2.u * barycentric_point.b + v3.u * barycentric_point.c;
-        const float vf = v1.v * barycentric_point.a + v2.v * barycentric_point.b + v3.v * barycentric_point.c;
-        auto ub = static_cast<uint32_t>(uf * texture->w);
-        auto vb = static_cast<uint32_t>(vf * texture->h);
-        uint32_t u = ub >= texture->w ? ub % texture->w : ub;
-        uint32_t v = vb >= texture->h ? vb % texture->h : vb;
+    // w of the projected center is its view depth, and the length of the second row scales view height to clip space
+    const BoundingSphere& sphere = model->get_bounding_sphere();
+    const float depth = mtx.data[12] * sphere.x + mtx.data[13] * sphere.y + mtx.data[14] * sphere.z + mtx.data[15];
+    if (depth <= sphere.radius) {
+        return 0;
+    }
+    const float scale = sqrtf(mtx.data[4] * mtx.data[4] + mtx.data[5] * mtx.data[5] + mtx.data[6] * mtx.data[6]);
+    const float radius = sphere.radius * scale / depth * geometry->height / 2.f;
 
-        Color color;
-        auto pixels = static_cast<uint8_t*>(texture->pixels);
-        const size_t pixel_idx = (v * texture->w + u) * texture->format->BytesPerPixel;
-        color.b = pixels[pixel_idx];
-        color.g = pixels[pixel_idx + 1];
-        color.r = pixels[pixel_idx + 2];
-        color.a = 255;
-        buffer[idx] = color.bgra;
-        zbuffer[idx] = z;
+    const float target_triangles = math::PI * radius * radius * lod_density;
+    for (size_t level = 0; level < lods.size(); level++) {
+        if (lods[level].index_buffer.size() / 3 <= target_triangles) {
+            return level;
+        }
+    }
+    return lods.size() - 1;
+}
+
+void Renderer::prepare(const CommandList& command_list, uint16_t width, uint16_t height, FrameGeometry& geometry) {
+    begin_geometry(geometry, width, height);
+    const std::vector<Command>& commands = command_list.get_commands();
+    const std::vector<math::Matrix<4, 4>>& matrices = command_list.get_matrices();
+
+    // Draws are only culled when they are met, and the visible ones of the whole frame are binned together
+    // before anything that changes the buffer or the state they depend on
+    for (size_t i = 0; i < commands.size(); i++) {
+        const Command& command = commands[i];
+        switch (command.type) {
+            case CommandType::Clear:
+                bin_visible_instances();
+                geometry.bins.push_back(GeometryBin {true, clear_color, pipeline_state, Texture {}, 0, 0});
+                break;
+            case CommandType::DrawModel:
+                cull_instances(command.model, matrices.data() + command.first_matrix, command.matrix_count, command.value);
+                break;
+            case CommandType::SetClearColor:
+                set_clear_color(command.color);
+                break;
+            case CommandType::SetLodDensity:
+                bin_visible_instances();
+                set_lod_density(command.value);
+                break;
+            case CommandType::SetPipelineState:
+                bin_visible_instances();
+                set_pipeline_state(command.pipeline_state);
+                break;
+        }
     }
+    bin_visible_instances();
+    this->geometry = nullptr;
 }
 
-BarycentricPoint Renderer::get_barycentric_coords(const Pixel& p, const Vertex& v1, const Vertex& v2, const Vertex& v3, float denom) const {
-    BarycentricPoint barycentric_point = {};
-    barycentric_point.a = ((v2.x * width - p.x) * (v3.y * height - p.y) - (v3.x * width - p.x) * (v2.y * height - p.y)) / denom;
-    barycentric_point.b = ((v3.x * width - p.x) * (v1.y * height - p.y) - (v1.x * width - p.x) * (v3.y * height - p.y)) / denom;
-    barycentric_point.c = 1.f - barycentric_point.a - barycentric_point.b;
-    return barycentric_point;
+void Renderer::rasterize(const FrameGeometry& geometry, RenderTarget& target) {
+    bind_target(target);
+    add_geometry_stats(stats, geometry.stats);
+
+    const std::vector<Vertex>& vertices = geometry.vertices;
+    const std::vector<uint32_t>& indices = geometry.indices;
+    for (const GeometryBin& bin : geometry.bins) {
+        if (bin.clear) {
+            clear(target, bin.clear_color);
+            continue;
+        }
+        span_pipeline = get_span_pipeline(bin.pipeline_state);
+        for (size_t i = bin.first_index; i < bin.first_index + bin.index_count; i += 3) {
+            draw_triangle(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], target, bin.texture);
+        }
+    }
 }
 
-void Renderer::resize_window(uint16_t width, uint16_t height) {
-    this->width = width;
-    this->height = height;
-    zbuffer.resize(width * height, std::numeric_limits<float>::max());
+void Renderer::submit(const CommandList& command_list, RenderTarget& target) {
+    prepare(command_list, target.get_width(), target.get_height(), immediate_geometry);
+    rasterize(immediate_geometry, target);
 }
 
 void Renderer::set_clear_color(Color color) {
     clear_color = color;
 }
 
+void Renderer::set_debug_view(DebugView view) {
+    debug_view = view;
+    coverage_counts.clear();
+    depth_pass_counts.clear();
+}
+
+void Renderer::set_depth_sort(DepthSort sort) {
+    depth_sort = sort;
+}
+
+void Renderer::set_lod_density(float triangles_per_pixel) {
+    lod_density = triangles_per_pixel;
+}
+
+void Renderer::set_pipeline_state(const PipelineState& state) {
+    pipeline_state = state;
+}
+
 }
@@ -1,45 +1,173 @@
 #pragma once
 
 #include "color.h"
+#include "frustum.h"
+#include "kernels.h"
+#include "pipeline.h"
+#include "render_target.h"
+#include "vertex.h"
 
 #include <cstdint>
 #include <vector>
 
-class SDL_Window;
 
 namespace renderer {
+class CommandList;
 class Model;
+struct Quantization;
 
-struct Pixel {
-    int64_t x;
-    int64_t y;
+constexpr size_t DEPTH_BUCKETS = 64;
+
+enum class DebugView {
+    None,
+    Coverage,
+    DepthComplexity
+};
+
+enum class DepthSort {
+    None,
+    Draws,
+    DrawsAndTriangles
+};
+
+struct Stats {
+    uint64_t covered_pixels;
+    uint64_t max_coverage;
+    uint64_t max_depth_passes;
+    uint64_t meshlets_culled;
+    uint64_t meshlets_drawn;
+    uint64_t models_culled;
+    uint64_t pixels_cleared;
+    uint64_t pixels_shaded;
+    uint64_t pixels_tested;
+    uint64_t triangles_culled;
+    uint64_t triangles_drawn;
+    uint64_t vertices_transformed;
 };
 
-struct BarycentricPoint {
-    float a;
-    float b;
-    float c;
+struct VisibleInstance {
+    const Model* model;
+    math::Matrix<4, 4> mtx;
+    Visibility visibility;
+    float depth;
+    float radius;
+    // Picked when the instance is binned
+    size_t lod;
+};
+
+// The triangles of one draw, or a clear, in the order they are rasterized
+struct GeometryBin {
+    // Clears the target to clear_color instead of drawing triangles
+    bool clear;
+    Color clear_color;
+    PipelineState pipeline_state;
+    Texture texture;
+    uint32_t first_index;
+    uint32_t index_count;
+};
+
+// The output of the geometry stage of a frame: the projected vertices that survived culling, three indices per
+// triangle into them, and the bins that group the triangles by draw. Its stats only hold the geometry counters.
+struct FrameGeometry {
+    std::vector<GeometryBin> bins;
+    uint16_t height;
+    std::vector<uint32_t> indices;
+    Stats stats;
+    std::vector<Vertex> vertices;
+    uint16_t width;
+};
+
+struct QueuedTriangle {
+    uint32_t index1;
+    uint32_t index2;
+    uint32_t index3;
+    uint32_t bucket;
 };
 
 class Renderer {
 public:
-    Renderer(const SDL_Window* window, uint16_t width, uint16_t height, Color clear_color);
-    void clear_buffer(uint32_t* buffer);
-    void draw_model(const Model* model, uint32_t* buffer, const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov);
-    void resize_window(uint16_t width, uint16_t height);
+    explicit Renderer(Color clear_color);
+    void clear_buffer(RenderTarget& target);
+    void draw_model(const Model* model, RenderTarget& target, const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov);
+    // Projection, culling setup and texture are shared by all instances, model_matrices holds one model matrix per instance
+    void draw_model_instanced(const Model* model, RenderTarget& target, const math::Matrix<4, 4>* model_matrices, size_t instance_count, float fov);
+    // Draws the full detail mesh with a programmable shader, defined in shader.h. It is depth tested and written,
+    // the pipeline state and the debug views don't apply.
+    template <typename ShaderType>
+    void draw_model_shaded(const Model* model, RenderTarget& target, const math::Matrix<4, 4>& model_mtx, float fov, const ShaderType& shader);
+    const Stats& get_stats() const;
+    void reset_stats();
     void set_clear_color(Color color);
+    // Replaces the texture color with a heatmap of how many times each pixel was covered or passed the depth test,
+    // and fills the depth complexity fields of the stats
+    void set_debug_view(DebugView view);
+    // Orders the visible draws of a submit front to back by their bounds, and optionally the triangles of each draw by depth bucket
+    void set_depth_sort(DepthSort sort);
+    // LODs are selected so that the model draws about this many triangles per covered pixel, zero always draws the full mesh
+    void set_lod_density(float triangles_per_pixel);
+    // Selects the rasterization loop specialized for the state, the debug views ignore it
+    void set_pipeline_state(const PipelineState& state);
+    // Executes a recorded command list against the buffer, the list is left untouched and can be submitted again
+    void submit(const CommandList& command_list, RenderTarget& target);
+
+    // The two halves of submit. prepare culls and transforms the draws of the list for a target of the given size
+    // into geometry, rasterize draws it. Both may run at the same time on different threads, for different frames,
+    // as long as no other method is called meanwhile except set_debug_view, which only affects rasterize.
+    void prepare(const CommandList& command_list, uint16_t width, uint16_t height, FrameGeometry& geometry);
+    void rasterize(const FrameGeometry& geometry, RenderTarget& target);
 private:
-    void draw_line(const Vertex& v1, const Vertex& v2, const Vertex& v3, float barycentric_denom, int64_t x1, int64_t x2, int64_t y, uint32_t* buffer, const SDL_Surface* texture);
-    void draw_pixel(const Pixel& p, const Vertex& v1, const Vertex& v2, const Vertex& v3, float barycentric_denom, uint32_t* buffer, const SDL_Surface* texture);
-    void draw_triangle(const Vertex& v1, const Vertex& v2, const Vertex& v3, uint32_t* buffer, const SDL_Surface* texture);
-    BarycentricPoint get_barycentric_coords(const Pixel& p, const Vertex& v1, const Vertex& v2, const Vertex& v3, float denom) const;
-    math::Matrix<4, 4> get_transform_matrix(const math::Matrix<4, 4>& rotation_mtx, const math::Matrix<4, 4>& translation_mtx, float fov) const;
-    Vertex transform_vertex(const Vertex& vertex, const math::Matrix<4, 4>& matrix) const;
+    void begin_geometry(FrameGeometry& geometry, uint16_t width, uint16_t height);
+    void begin_transform(size_t vertex_count);
+    void bin_queued_triangles();
+    void bin_visible_instances();
+    // Takes the size of the target for the projection and sizes the debug counts to it
+    void bind_target(const RenderTarget& target);
+    void cull_instances(const Model* model, const math::Matrix<4, 4>* model_matrices, size_t instance_count, float fov);
+    void clear(RenderTarget& target, Color color);
+    void draw_debug_pixel(const ScreenTriangle& triangle, int64_t x, int64_t y, RenderTarget& target);
+    void draw_instance(const VisibleInstance& instance);
+    void draw_line(const ScreenTriangle& triangle, int64_t x1, int64_t x2, int64_t y, RenderTarget& target, const Texture& texture);
+    template <typename ShaderType>
+    void draw_shaded_triangle(const ShaderType& shader, uint32_t index1, uint32_t index2, uint32_t index3, RenderTarget& target);
+    void draw_triangle(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, RenderTarget& target, const Texture& texture);
+    void draw_triangles(const VisibleInstance& instance, const std::vector<uint32_t>& index_buffer, const math::Matrix<4, 4>& mtx, size_t first_index, size_t index_count, Visibility visibility);
+    template <typename VertexType>
+    void draw_triangles(const VisibleInstance& instance, const std::vector<uint32_t>& index_buffer, const std::vector<VertexType>& vertex_buffer, const math::Matrix<4, 4>& mtx, size_t first_index, size_t index_count, Visibility visibility);
+    float get_max_scale(const math::Matrix<4, 4>& mtx) const;
+    math::Matrix<4, 4> get_projection_matrix(float fov, uint16_t width, uint16_t height) const;
+    size_t select_lod(const Model* model, const math::Matrix<4, 4>& mtx) const;
+    template <typename VertexType>
+    void transform_vertices(const std::vector<uint32_t>& index_buffer, const std::vector<VertexType>& vertex_buffer, const Quantization& quantization, const math::Matrix<4, 4>& mtx, size_t first_index, size_t index_count);
 
     Color clear_color;
-    uint16_t height;
-    uint16_t width;
-    const SDL_Window* window;
-    std::vector<float> zbuffer;
+    std::vector<uint16_t> coverage_counts;
+    DebugView debug_view = DebugView::None;
+    std::vector<uint16_t> depth_pass_counts;
+    DepthSort depth_sort = DepthSort::Draws;
+    // The output of the geometry stage while it runs
+    FrameGeometry* geometry = nullptr;
+    uint16_t height = 0;
+    // Used by the draws that don't go through a command list, they are prepared and rasterized right away
+    FrameGeometry immediate_geometry {};
+    // The draw order of visible_instances
+    std::vector<uint32_t> instance_order;
+    Kernels kernels;
+    float lod_density = 0.5f;
+    std::vector<uint32_t> pending_vertices;
+    PipelineState pipeline_state;
+    std::vector<QueuedTriangle> queued_triangles;
+    std::vector<float> shaded_varyings;
+    std::vector<QueuedTriangle> sorted_triangles;
+    SpanFragments span_fragments;
+    SpanPipeline span_pipeline;
+    Stats stats {};
+    uint32_t transform_stamp = 0;
+    std::vector<uint32_t> transform_stamps;
+    std::vector<TransformedVertex> transformed_vertices;
+    std::vector<Vertex> unpacked_vertices;
+    // Where each transformed vertex of the current draw went in the frame geometry
+    std::vector<uint32_t> vertex_remap;
+    std::vector<VisibleInstance> visible_instances;
+    uint16_t width = 0;
 };
 }
@@ -0,0 +1,137 @@
+#include "resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace renderer {
+namespace {
+// Weight of the newest frame in the average
+constexpr double FRAME_TIME_SMOOTHING = 0.2;
+// Frames to wait after a change before the next one
+constexpr size_t SETTLE_FRAMES = 4;
+// The scale drops above budget * SHRINK_THRESHOLD and grows below budget / GROW_THRESHOLD
+constexpr double SHRINK_THRESHOLD = 1.05;
+constexpr double GROW_THRESHOLD = 1.15;
+// Scales are rounded to this step, so that the target is only resized for a real change
+constexpr float SCALE_STEP = 1.f / 32.f;
+
+// Blends two BGRA pixels by weight / 256, two channels at a time
+uint32_t lerp_pixel(uint32_t a, uint32_t b, uint32_t weight) {
+    const uint32_t inverse = 256 - weight;
+    const uint32_t red_blue = (((a & 0x00ff00ff) * inverse + (b & 0x00ff00ff) * weight) >> 8) & 0x00ff00ff;
+    const uint32_t alpha_green = (((a >> 8) & 0x00ff00ff) * inverse + ((b >> 8) & 0x00ff00ff) * weight) & 0xff00ff00;
+    return red_blue | alpha_green;
+}
+
+void upscale_nearest(const RenderTarget& source, RenderTarget& destination) {
+    const uint16_t width = destination.get_width();
+    const uint16_t height = destination.get_height();
+
+    // 16.16 fixed point, every pixel samples the source at its center
+    const uint32_t step_x = (static_cast<uint32_t>(source.get_width()) << 16) / width;
+    const uint32_t step_y = (static_cast<uint32_t>(source.get_height()) << 16) / height;
+    for (size_t y = 0; y < height; y++) {
+        const uint32_t* source_row = source.get_color_row((y * step_y + step_y / 2) >> 16);
+        uint32_t* destination_row = destination.get_color_row(y);
+        uint32_t position = step_x / 2;
+        for (size_t x = 0; x < width; x++) {
+            destination_row[x] = source_row[position >> 16];
+            position += step_x;
+        }
+    }
+}
+
+void upscale_bilinear(const RenderTarget& source, RenderTarget& destination) {
+    const uint16_t width = destination.get_width();
+    const uint16_t height = destination.get_height();
+    const int64_t max_x = source.get_width() - 1;
+    const int64_t max_y = source.get_height() - 1;
+
+    // 16.16 fixed point, pixel centers are mapped onto pixel centers and the edges are clamped
+    const int64_t step_x = (static_cast<int64_t>(source.get_width()) << 16) / width;
+    const int64_t step_y = (static_cast<int64_t>(source.get_height()) << 16) / height;
+    int64_t position_y = step_y / 2 - (1 << 15);
+    for (size_t y = 0; y < height; y++, position_y += step_y) {
+        const int64_t clamped_y = std::clamp<int64_t>(position_y, 0, max_y << 16);
+        const int64_t y0 = clamped_y >> 16;
+        const auto weight_y = static_cast<uint32_t>((clamped_y >> 8) & 0xff);
+        const uint32_t* row0 = source.get_color_row(y0);
+        const uint32_t* row1 = source.get_color_row(std::min(y0 + 1, max_y));
+        uint32_t* destination_row = destination.get_color_row(y);
+
+        int64_t position_x = step_x / 2 - (1 << 15);
+        for (size_t x = 0; x < width; x++, position_x += step_x) {
+            const int64_t clamped_x = std::clamp<int64_t>(position_x, 0, max_x << 16);
+            const int64_t x0 = clamped_x >> 16;
+            const int64_t x1 = std::min(x0 + 1, max_x);
+            const auto weight_x = static_cast<uint32_t>((clamped_x >> 8) & 0xff);
+            const uint32_t top = lerp_pixel(row0[x0], row0[x1], weight_x);
+            const uint32_t bottom = lerp_pixel(row1[x0], row1[x1], weight_x);
+            destination_row[x] = lerp_pixel(top, bottom, weight_y);
+        }
+    }
+}
+}
+
+bool parse_upscale_filter(const std::string& name, UpscaleFilter& filter) {
+    if (name == "nearest") {
+        filter = UpscaleFilter::Nearest;
+    } else if (name == "bilinear") {
+        filter = UpscaleFilter::Bilinear;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+ResolutionController::ResolutionController(double budget_seconds, float min_scale, float max_scale)
+        : budget_seconds(budget_seconds), max_scale(max_scale), min_scale(min_scale), scale(max_scale) {
+}
+
+float ResolutionController::update(double frame_seconds) {
+    average_seconds = average_seconds == 0. ? frame_seconds : average_seconds + (frame_seconds - average_seconds) * FRAME_TIME_SMOOTHING;
+    if (++frames_since_change < SETTLE_FRAMES || average_seconds <= 0.) {
+        return scale;
+    }
+
+    const double ratio = budget_seconds / average_seconds;
+    if (ratio * SHRINK_THRESHOLD >= 1. && ratio <= GROW_THRESHOLD) {
+        return scale;
+    }
+
+    // Growing aims at the budget minus the headroom, so that it doesn't overshoot and shrink right after
+    const double target_ratio = ratio > 1. ? ratio / GROW_THRESHOLD : ratio;
+    float next_scale = static_cast<float>(scale * std::sqrt(target_ratio));
+    next_scale = std::clamp(std::round(next_scale / SCALE_STEP) * SCALE_STEP, min_scale, max_scale);
+    if (next_scale != scale) {
+        // The average is carried over as a prediction for the new scale
+        average_seconds *= static_cast<double>(next_scale * next_scale) / (scale * scale);
+        scale = next_scale;
+        frames_since_change = 0;
+    }
+    return scale;
+}
+
+float ResolutionController::get_scale() const {
+    return scale;
+}
+
+void ResolutionController::get_scaled_size(uint16_t width, uint16_t height, float scale, uint16_t& scaled_width, uint16_t& scaled_height) {
+    scaled_width = static_cast<uint16_t>(std::max(std::lround(width * scale), 1L));
+    scaled_height = static_cast<uint16_t>(std::max(std::lround(height * scale), 1L));
+}
+
+void upscale(const RenderTarget& source, RenderTarget& destination, UpscaleFilter filter) {
+    if (source.get_width() == destination.get_width() && source.get_height() == destination.get_height()) {
+        for (size_t y = 0; y < destination.get_height(); y++) {
+            std::memcpy(destination.get_color_row(y), source.get_color_row(y), destination.get_width() * sizeof(uint32_t));
+        }
+    } else if (filter == UpscaleFilter::Nearest) {
+        upscale_nearest(source, destination);
+    } else {
+        upscale_bilinear(source, destination);
+    }
+    destination.mark_all_dirty();
+}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "render_target.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace renderer {
+enum class UpscaleFilter : uint8_t {
+    Nearest,
+    Bilinear
+};
+
+bool parse_upscale_filter(const std::string& name, UpscaleFilter& filter);
+
+// Picks the resolution scale, per axis, that keeps the render time of a frame within a budget. The pixel work grows with
+// the square of the scale, so the scale follows the square root of budget / average frame time. It only drops when
+// the average is over the budget and only grows back with some headroom, and waits a few frames after every change
+// for the average to settle, so that it doesn't oscillate.
+class ResolutionController {
+public:
+    ResolutionController(double budget_seconds, float min_scale = 0.5f, float max_scale = 1.f);
+    // Feeds the render time of the frame drawn at the current scale, returns the scale for the next one
+    float update(double frame_seconds);
+    float get_scale() const;
+    // The size of a target at the scale, at least a pixel
+    static void get_scaled_size(uint16_t width, uint16_t height, float scale, uint16_t& scaled_width, uint16_t& scaled_height);
+private:
+    double average_seconds = 0.;
+    double budget_seconds;
+    size_t frames_since_change = 0;
+    float max_scale;
+    float min_scale;
+    float scale;
+};
+
+// Stretches the color buffer of source over the whole of destination, the depth buffer is left untouched
+void upscale(const RenderTarget& source, RenderTarget& destination, UpscaleFilter filter);
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "color.h"
+#include "frustum.h"
+#include "kernels.h"
+#include "matrix.h"
+#include "model.h"
+#include "quantization.h"
+#include "rasterizer.h"
+#include "renderer.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace renderer {
+// Base of the programmable shaders. A shader derives from Shader<Derived, N>, where N is the number of float varyings,
+// and implements
+//
+//     math::Vector<4> vertex(const Vertex& vertex, const math::Matrix<4, 4>& mtx, Varyings& varyings) const;
+//     uint32_t fragment(const Varyings& varyings) const;
+//
+// vertex returns the clip space position and fills the varyings, mtx maps the stored position to clip space.
+// fragment returns the BGRA color of a pixel from the varyings, interpolated perspective correct across the triangle.
+// Both are called on the derived type, so they inline into the rasterization loop.
+template <typename Derived, size_t VaryingCount>
+class Shader {
+public:
+    static constexpr size_t VARYING_COUNT = VaryingCount;
+    using Varyings = std::array<float, VaryingCount>;
+
+    math::Vector<4> shade_vertex(const Vertex& vertex, const math::Matrix<4, 4>& mtx, Varyings& varyings) const {
+        return static_cast<const Derived&>(*this).vertex(vertex, mtx, varyings);
+    }
+
+    uint32_t shade_fragment(const Varyings& varyings) const {
+        return static_cast<const Derived&>(*this).fragment(varyings);
+    }
+protected:
+    // Coordinates outside of [0, 1) wrap around
+    static uint32_t sample(const Texture& texture, float u, float v) {
+        return sample_texel(texture, u, v);
+    }
+};
+
+// The textured output of the fixed pipeline with perspective correct interpolation
+class TextureShader : public Shader<TextureShader, 2> {
+public:
+    explicit TextureShader(const Texture& texture) : texture(texture) {}
+
+    math::Vector<4> vertex(const Vertex& vertex, const math::Matrix<4, 4>& mtx, Varyings& varyings) const {
+        varyings = {vertex.u, vertex.v};
+        return math::mul(mtx, vertex.xyzw);
+    }
+
+    uint32_t fragment(const Varyings& varyings) const {
+        return sample(texture, varyings[0], varyings[1]);
+    }
+private:
+    Texture texture;
+};
+
+// Fades the texture into a fog color between two view depths
+class FogShader : public Shader<FogShader, 3> {
+public:
+    FogShader(const Texture& texture, Color fog_color, float fog_start, float fog_end)
+            : texture(texture), fog_color(fog_color), fog_start(fog_start), fog_end(fog_end) {}
+
+    math::Vector<4> vertex(const Vertex& vertex, const math::Matrix<4, 4>& mtx, Varyings& varyings) const {
+        const math::Vector<4> position = math::mul(mtx, vertex.xyzw);
+        varyings = {vertex.u, vertex.v, position.data[3]};
+        return position;
+    }
+
+    uint32_t fragment(const Varyings& varyings) const {
+        const uint32_t texel = sample(texture, varyings[0], varyings[1]);
+        const float fog = std::clamp((varyings[2] - fog_start) / (fog_end - fog_start), 0.f, 1.f);
+        uint32_t color = 0xff000000;
+        for (uint32_t shift = 0; shift < 24; shift += 8) {
+            const float channel = static_cast<float>((texel >> shift) & 0xff);
+            const float fog_channel = static_cast<float>((fog_color.bgra >> shift) & 0xff);
+            color |= static_cast<uint32_t>(channel + (fog_channel - channel) * fog) << shift;
+        }
+        return color;
+    }
+private:
+    Texture texture;
+    Color fog_color;
+    float fog_start;
+    float fog_end;
+};
+
+template <typename ShaderType>
+void Renderer::draw_model_shaded(const Model* model, RenderTarget& target, const math::Matrix<4, 4>& model_mtx, float fov, const ShaderType& shader) {
+    constexpr size_t varying_count = ShaderType::VARYING_COUNT;
+    const std::vector<uint32_t>& index_buffer = model->get_lods()[0].index_buffer;
+
+    bind_target(target);
+    const math::Matrix<4, 4> mtx = math::mul(get_projection_matrix(fov, width, height), model_mtx);
+    const Visibility visibility = Frustum(mtx).classify(model->get_bounding_box());
+    if (visibility == Visibility::Outside) {
+        stats.models_culled++;
+        stats.triangles_culled += index_buffer.size() / 3;
+        return;
+    }
+
+    math::Matrix<4, 4> vertex_mtx = mtx;
+    if (model->is_quantized()) {
+        vertex_mtx = math::mul(mtx, get_dequantization_matrix(model->get_quantization()));
+    }
+
+    // Every vertex goes through the vertex shader once, the varyings are stored next to each other per vertex
+    const size_t vertex_count = model->get_vertex_count();
+    begin_transform(vertex_count);
+    if (shaded_varyings.size() < vertex_count * varying_count) {
+        shaded_varyings.resize(vertex_count * varying_count);
+    }
+    for (size_t i = 0; i < vertex_count; i++) {
+        const Vertex vertex = model->is_quantized()
+                ? unpack_vertex(model->get_quantized_vertex_buffer()[i], model->get_quantization())
+                : model->get_vertex_buffer()[i];
+        typename ShaderType::Varyings varyings {};
+        const math::Vector<4> position = shader.shade_vertex(vertex, vertex_mtx, varyings);
+
+        TransformedVertex& transformed = transformed_vertices[i];
+        transformed.clip_code = get_clip_code(position);
+        if ((transformed.clip_code & CLIP_NEAR) == 0) {
+            transformed.vertex = project_vertex(vertex, position);
+        }
+        std::copy(varyings.begin(), varyings.end(), shaded_varyings.begin() + i * varying_count);
+    }
+    stats.vertices_transformed += vertex_count;
+
+    for (size_t i = 0; i < index_buffer.size(); i += 3) {
+        const uint32_t index1 = index_buffer[i];
+        const uint32_t index2 = index_buffer[i + 1];
+        const uint32_t index3 = index_buffer[i + 2];
+
+        if (visibility != Visibility::Inside) {
+            const uint8_t code1 = transformed_vertices[index1].clip_code;
+            const uint8_t code2 = transformed_vertices[index2].clip_code;
+            const uint8_t code3 = transformed_vertices[index3].clip_code;
+            if ((code1 & code2 & code3) != 0 || ((code1 | code2 | code3) & CLIP_NEAR) != 0) {
+                stats.triangles_culled++;
+                continue;
+            }
+        }
+
+        stats.triangles_drawn++;
+        draw_shaded_triangle(shader, index1, index2, index3, target);
+    }
+}
+
+template <typename ShaderType>
+void Renderer::draw_shaded_triangle(const ShaderType& shader, uint32_t index1, uint32_t index2, uint32_t index3, RenderTarget& target) {
+    constexpr size_t varying_count = ShaderType::VARYING_COUNT;
+    using Varyings = typename ShaderType::Varyings;
+
+    const uint32_t indices[3] = {index1, index2, index3};
+    const std::array<uint32_t, 3> order = sort_triangle(transformed_vertices[index1].vertex, transformed_vertices[index2].vertex, transformed_vertices[index3].vertex);
+    const ScreenTriangle triangle = make_screen_triangle(transformed_vertices[indices[order[0]]].vertex, transformed_vertices[indices[order[1]]].vertex,
+                                                         transformed_vertices[indices[order[2]]].vertex, width, height);
+
+    // The varyings are interpolated divided by w and divided back per pixel
+    Varyings varyings[3];
+    for (size_t i = 0; i < 3; i++) {
+        const float* vertex_varyings = shaded_varyings.data() + indices[order[i]] * varying_count;
+        for (size_t j = 0; j < varying_count; j++) {
+            varyings[i][j] = vertex_varyings[j] * triangle.inv_w[i];
+        }
+    }
+
+    Rect bounds {};
+    walk_triangle(triangle, width, height, [&](int64_t x1, int64_t x2, int64_t y) {
+        bounds.expand(get_span_rect(x1, x2, y));
+        stats.pixels_tested += x2 - x1 + 1;
+        uint32_t* buffer_row = target.get_color_row(y);
+        float* zbuffer_row = target.get_depth_row(y);
+        const float py = static_cast<float>(y);
+
+        for (int64_t x = x1; x <= x2; x++) {
+            float a;
+            float b;
+            float c;
+            get_barycentric_coords(triangle, static_cast<float>(x), py, a, b, c);
+            const float z = triangle.z[0] * a + triangle.z[1] * b + triangle.z[2] * c;
+            if (!(z < zbuffer_row[x])) {
+                continue;
+            }
+            zbuffer_row[x] = z;
+
+            const float w = 1.f / (triangle.inv_w[0] * a + triangle.inv_w[1] * b + triangle.inv_w[2] * c);
+            Varyings interpolated;
+            for (size_t j = 0; j < varying_count; j++) {
+                interpolated[j] = (varyings[0][j] * a + varyings[1][j] * b + varyings[2][j] * c) * w;
+            }
+            buffer_row[x] = shader.shade_fragment(interpolated);
+            stats.pixels_shaded++;
+        }
+    });
+    target.mark_dirty(bounds);
+}
+}
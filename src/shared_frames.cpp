@@ -0,0 +1,206 @@
+#include "shared_frames.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace renderer {
+namespace {
+size_t get_slot_size(uint16_t width, uint16_t height) {
+    const size_t bytes = RenderTarget::get_stride(width) * height * sizeof(uint32_t);
+    return (bytes + SHARED_FRAMES_SLOT_ALIGNMENT - 1) / SHARED_FRAMES_SLOT_ALIGNMENT * SHARED_FRAMES_SLOT_ALIGNMENT;
+}
+
+const uint8_t* get_slot_pixels(const SharedFramesHeader* header, size_t slot) {
+    return reinterpret_cast<const uint8_t*>(header) + SHARED_FRAMES_SLOT_ALIGNMENT + slot * header->slot_size;
+}
+}
+
+#if defined(_WIN32)
+SharedFrameRing::SharedFrameRing(const std::string& name, uint16_t width, uint16_t height, size_t)
+        : name(name), target(width, height) {
+    std::cerr << "Shared memory frames need POSIX shared memory" << std::endl;
+}
+
+SharedFrameRing::~SharedFrameRing() = default;
+
+SharedFrameReader::SharedFrameReader(const std::string&) {
+    std::cerr << "Shared memory frames need POSIX shared memory" << std::endl;
+}
+
+SharedFrameReader::~SharedFrameReader() = default;
+#else
+SharedFrameRing::SharedFrameRing(const std::string& name, uint16_t width, uint16_t height, size_t slot_count)
+        : name(name), target(width, height) {
+    slot_count = std::clamp<size_t>(slot_count, 2, SHARED_FRAMES_MAX_SLOTS);
+    const size_t slot_size = get_slot_size(width, height);
+    mapping_size = SHARED_FRAMES_SLOT_ALIGNMENT + slot_count * slot_size;
+
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(mapping_size)) != 0) {
+        std::cerr << "Failed to create shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+        }
+        return;
+    }
+    void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    // The object starts zeroed, the magic is written last so that a reader never sees a half initialized header
+    header = new (mapping) SharedFramesHeader {};
+    header->version = SHARED_FRAMES_VERSION;
+    header->width = width;
+    header->height = height;
+    header->stride = static_cast<uint32_t>(RenderTarget::get_stride(width));
+    header->slot_count = static_cast<uint32_t>(slot_count);
+    header->slot_size = slot_size;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_FRAMES_MAGIC;
+}
+
+SharedFrameRing::~SharedFrameRing() {
+    if (header == nullptr) {
+        return;
+    }
+    header->closed.store(1, std::memory_order_release);
+    target.attach_color_buffer(nullptr);
+    munmap(header, mapping_size);
+    shm_unlink(name.c_str());
+}
+
+SharedFrameReader::SharedFrameReader(const std::string& name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return;
+    }
+    struct stat status {};
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < SHARED_FRAMES_SLOT_ALIGNMENT) {
+        close(fd);
+        return;
+    }
+    const auto size = static_cast<size_t>(status.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+
+    const auto* mapped_header = static_cast<const SharedFramesHeader*>(mapping);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (mapped_header->magic != SHARED_FRAMES_MAGIC || mapped_header->version != SHARED_FRAMES_VERSION
+            || SHARED_FRAMES_SLOT_ALIGNMENT + mapped_header->slot_count * mapped_header->slot_size > size) {
+        munmap(mapping, size);
+        return;
+    }
+    header = mapped_header;
+    mapping_size = size;
+}
+
+SharedFrameReader::~SharedFrameReader() {
+    if (header != nullptr) {
+        munmap(const_cast<SharedFramesHeader*>(header), mapping_size);
+    }
+}
+#endif
+
+bool SharedFrameRing::is_open() const {
+    return header != nullptr;
+}
+
+RenderTarget& SharedFrameRing::begin_frame() {
+    if (header != nullptr) {
+        const size_t slot = next_frame % header->slot_count;
+        SharedFrameSlot& shared_slot = header->slots[slot];
+        shared_slot.sequence.store(shared_slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        target.attach_color_buffer(reinterpret_cast<uint32_t*>(const_cast<uint8_t*>(get_slot_pixels(header, slot))));
+    }
+    return target;
+}
+
+void SharedFrameRing::end_frame() {
+    if (header == nullptr) {
+        return;
+    }
+    SharedFrameSlot& shared_slot = header->slots[next_frame % header->slot_count];
+    shared_slot.frame.store(next_frame, std::memory_order_relaxed);
+    shared_slot.sequence.store(shared_slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    header->frame_counter.store(++next_frame, std::memory_order_release);
+}
+
+uint64_t SharedFrameRing::get_frame_counter() const {
+    return next_frame;
+}
+
+bool SharedFrameReader::is_open() const {
+    return header != nullptr;
+}
+
+bool SharedFrameReader::is_closed() const {
+    return header == nullptr || header->closed.load(std::memory_order_acquire) != 0;
+}
+
+uint16_t SharedFrameReader::get_width() const {
+    return header != nullptr ? static_cast<uint16_t>(header->width) : 0;
+}
+
+uint16_t SharedFrameReader::get_height() const {
+    return header != nullptr ? static_cast<uint16_t>(header->height) : 0;
+}
+
+uint64_t SharedFrameReader::get_frame_counter() const {
+    return header != nullptr ? header->frame_counter.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFrameReader::read_latest(uint64_t& frame_counter, void* pixels, size_t pitch, uint64_t& torn_reads, size_t retries) const {
+    if (header == nullptr) {
+        return false;
+    }
+    for (size_t attempt = 0; attempt <= retries; attempt++) {
+        const uint64_t counter = header->frame_counter.load(std::memory_order_acquire);
+        if (counter <= frame_counter) {
+            return false;
+        }
+        const size_t slot = (counter - 1) % header->slot_count;
+        const SharedFrameSlot& shared_slot = header->slots[slot];
+        const uint64_t sequence = shared_slot.sequence.load(std::memory_order_acquire);
+        const uint64_t slot_frame = shared_slot.frame.load(std::memory_order_relaxed);
+        if ((sequence & 1) != 0) {
+            torn_reads++;
+            continue;
+        }
+
+        const uint8_t* source = get_slot_pixels(header, slot);
+        const size_t row_bytes = header->width * sizeof(uint32_t);
+        for (size_t y = 0; y < header->height; y++) {
+            std::memcpy(static_cast<uint8_t*>(pixels) + y * pitch, source + y * header->stride * sizeof(uint32_t), row_bytes);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared_slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            torn_reads++;
+            continue;
+        }
+        frame_counter = slot_frame + 1;
+        return true;
+    }
+    return false;
+}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "render_target.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace renderer {
+constexpr uint32_t SHARED_FRAMES_MAGIC = 0x42465253;
+constexpr uint32_t SHARED_FRAMES_VERSION = 1;
+constexpr size_t SHARED_FRAMES_MAX_SLOTS = 8;
+// The pixels of the first slot start at this offset, every slot is a multiple of it
+constexpr size_t SHARED_FRAMES_SLOT_ALIGNMENT = 4096;
+
+struct SharedFrameSlot {
+    // A seqlock, odd while the renderer draws into the slot
+    std::atomic<uint64_t> sequence;
+    // The number of the frame in the slot, only meaningful while sequence is even
+    std::atomic<uint64_t> frame;
+};
+
+// The start of the shared memory object, followed by slot_count slots of stride * height BGRA pixels
+struct SharedFramesHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    // In pixels, like RenderTarget
+    uint32_t stride;
+    uint32_t slot_count;
+    uint64_t slot_size;
+    // Frames published so far, the latest one is in slot (frame_counter - 1) % slot_count
+    std::atomic<uint64_t> frame_counter;
+    // Set when the renderer is done, no frame follows
+    std::atomic<uint32_t> closed;
+    SharedFrameSlot slots[SHARED_FRAMES_MAX_SLOTS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The counters are shared between processes");
+static_assert(sizeof(SharedFramesHeader) <= SHARED_FRAMES_SLOT_ALIGNMENT);
+
+// A POSIX shared memory ring of framebuffers the renderer draws into directly. Every frame takes the next slot,
+// so a reader has slot_count - 1 frames of time to look at the latest one before it is overwritten, and the renderer
+// never waits for readers. Readers detect a frame that was overwritten under them with the slot's seqlock.
+class SharedFrameRing {
+public:
+    // name is a shm_open name such as "/software_renderer". An existing object of the same name is replaced.
+    SharedFrameRing(const std::string& name, uint16_t width, uint16_t height, size_t slot_count);
+    // Marks the ring closed for the readers and unlinks it, mappings of the readers stay valid
+    ~SharedFrameRing();
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    bool is_open() const;
+    // The target to render the next frame into, backed by the next slot until end_frame
+    RenderTarget& begin_frame();
+    // Publishes the frame rendered since begin_frame
+    void end_frame();
+    uint64_t get_frame_counter() const;
+private:
+    SharedFramesHeader* header = nullptr;
+    size_t mapping_size = 0;
+    std::string name;
+    uint64_t next_frame = 0;
+    RenderTarget target;
+};
+
+// A read-only view of a ring created by another process
+class SharedFrameReader {
+public:
+    explicit SharedFrameReader(const std::string& name);
+    ~SharedFrameReader();
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+    bool is_open() const;
+    bool is_closed() const;
+    uint16_t get_width() const;
+    uint16_t get_height() const;
+    uint64_t get_frame_counter() const;
+    // Copies the latest frame into pixels with the given pitch in bytes if the counter moved past frame_counter, which
+    // is then set to the counter of the copied frame, 0 reads any. Retries up to `retries` times while the renderer
+    // overwrites the slot during the copy, which is counted in torn_reads.
+    bool read_latest(uint64_t& frame_counter, void* pixels, size_t pitch, uint64_t& torn_reads, size_t retries = 4) const;
+private:
+    const SharedFramesHeader* header = nullptr;
+    size_t mapping_size = 0;
+};
+}
@@ -0,0 +1,234 @@
+#include "simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace renderer {
+namespace {
+struct Quadric {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+};
+
+struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+};
+
+void add_quadric(Quadric& q, const Quadric& other) {
+    q.a2 += other.a2;
+    q.ab += other.ab;
+    q.ac += other.ac;
+    q.ad += other.ad;
+    q.b2 += other.b2;
+    q.bc += other.bc;
+    q.bd += other.bd;
+    q.c2 += other.c2;
+    q.cd += other.cd;
+    q.d2 += other.d2;
+}
+
+double get_error(const Quadric& q, const Vertex& v) {
+    const double x = v.x;
+    const double y = v.y;
+    const double z = v.z;
+    return q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+            + q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+            + q.c2 * z * z + 2.0 * q.cd * z
+            + q.d2;
+}
+
+void get_normal(const Vertex& v1, const Vertex& v2, const Vertex& v3, double normal[3]) {
+    const double ax = v2.x - v1.x;
+    const double ay = v2.y - v1.y;
+    const double az = v2.z - v1.z;
+    const double bx = v3.x - v1.x;
+    const double by = v3.y - v1.y;
+    const double bz = v3.z - v1.z;
+    normal[0] = ay * bz - az * by;
+    normal[1] = az * bx - ax * bz;
+    normal[2] = ax * by - ay * bx;
+}
+
+std::vector<Quadric> build_quadrics(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices) {
+    std::vector<Quadric> quadrics(vertices.size(), Quadric {});
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const Vertex& v1 = vertices[indices[i]];
+        double normal[3];
+        get_normal(v1, vertices[indices[i + 1]], vertices[indices[i + 2]], normal);
+
+        const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length == 0.0) {
+            continue;
+        }
+
+        // The plane quadric is weighted by the triangle area, which is half of the normal length
+        const double a = normal[0] / length;
+        const double b = normal[1] / length;
+        const double c = normal[2] / length;
+        const double d = -(a * v1.x + b * v1.y + c * v1.z);
+        const double w = length / 2.0;
+        const Quadric quadric = {
+                w * a * a, w * a * b, w * a * c, w * a * d,
+                w * b * b, w * b * c, w * b * d,
+                w * c * c, w * c * d,
+                w * d * d
+        };
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            add_quadric(quadrics[indices[i + corner]], quadric);
+        }
+    }
+    return quadrics;
+}
+
+// Edges used by a single triangle are borders or texture seams, edges used by more than two are non-manifold
+std::vector<bool> find_locked_vertices(const std::vector<uint32_t>& indices, size_t vertex_count) {
+    std::unordered_map<uint64_t, uint32_t> edge_counts;
+    edge_counts.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (size_t corner = 0; corner < 3; corner++) {
+            const uint32_t a = indices[i + corner];
+            const uint32_t b = indices[i + (corner + 1) % 3];
+            edge_counts[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+        }
+    }
+
+    std::vector<bool> locked(vertex_count, false);
+    for (const auto& [edge, count] : edge_counts) {
+        if (count != 2) {
+            locked[edge >> 32] = true;
+            locked[edge & 0xffffffff] = true;
+        }
+    }
+    return locked;
+}
+
+bool flips_triangles(uint32_t from, uint32_t to, const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                     const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& triangles) {
+    for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++) {
+        const size_t triangle = triangles[i] * 3;
+        uint32_t corners[3] = {indices[triangle], indices[triangle + 1], indices[triangle + 2]};
+        if (corners[0] == to || corners[1] == to || corners[2] == to) {
+            continue;
+        }
+
+        double before[3];
+        get_normal(vertices[corners[0]], vertices[corners[1]], vertices[corners[2]], before);
+        for (uint32_t& corner : corners) {
+            if (corner == from) {
+                corner = to;
+            }
+        }
+        double after[3];
+        get_normal(vertices[corners[0]], vertices[corners[1]], vertices[corners[2]], after);
+
+        if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+std::vector<uint32_t> simplify(const std::vector<uint32_t>& index_buffer, const std::vector<Vertex>& vertex_buffer, size_t target_index_count) {
+    std::vector<uint32_t> indices = index_buffer;
+    std::vector<Quadric> quadrics = build_quadrics(indices, vertex_buffer);
+    const std::vector<bool> locked = find_locked_vertices(indices, vertex_buffer.size());
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertex_buffer.size());
+    std::vector<bool> collapsed(vertex_buffer.size());
+
+    while (indices.size() > target_index_count) {
+        offsets.assign(vertex_buffer.size() + 1, 0);
+        for (uint32_t index : indices) {
+            offsets[index + 1]++;
+        }
+        for (size_t vertex = 0; vertex < vertex_buffer.size(); vertex++) {
+            offsets[vertex + 1] += offsets[vertex];
+        }
+        triangles.resize(indices.size());
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // Every edge is seen from both of its triangles, the duplicates are harmless
+        collapses.clear();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (size_t corner = 0; corner < 3; corner++) {
+                const uint32_t a = indices[i + corner];
+                const uint32_t b = indices[i + (corner + 1) % 3];
+                if (a > b || (locked[a] && locked[b])) {
+                    continue;
+                }
+
+                Quadric quadric = quadrics[a];
+                add_quadric(quadric, quadrics[b]);
+                const double cost_ab = locked[a] ? std::numeric_limits<double>::max() : get_error(quadric, vertex_buffer[b]);
+                const double cost_ba = locked[b] ? std::numeric_limits<double>::max() : get_error(quadric, vertex_buffer[a]);
+                if (cost_ab <= cost_ba) {
+                    collapses.push_back(Collapse {cost_ab, a, b});
+                } else {
+                    collapses.push_back(Collapse {cost_ba, b, a});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        for (size_t vertex = 0; vertex < vertex_buffer.size(); vertex++) {
+            remap[vertex] = static_cast<uint32_t>(vertex);
+        }
+        std::fill(collapsed.begin(), collapsed.end(), false);
+
+        // A collapse removes two triangles on a closed surface, so stop once the target is roughly met
+        const size_t collapse_limit = (indices.size() - target_index_count) / 6 + 1;
+        size_t collapse_count = 0;
+        for (const Collapse& collapse : collapses) {
+            if (collapse_count == collapse_limit) {
+                break;
+            }
+            if (collapsed[collapse.from] || collapsed[collapse.to]) {
+                continue;
+            }
+            if (flips_triangles(collapse.from, collapse.to, indices, vertex_buffer, offsets, triangles)) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            add_quadric(quadrics[collapse.to], quadrics[collapse.from]);
+            collapsed[collapse.from] = true;
+            collapsed[collapse.to] = true;
+            collapse_count++;
+        }
+
+        if (collapse_count == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            const uint32_t a = remap[indices[i]];
+            const uint32_t b = remap[indices[i + 1]];
+            const uint32_t c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c) {
+                continue;
+            }
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    return indices;
+}
+}
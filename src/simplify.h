@@ -0,0 +1,12 @@
+#pragma once
+
+#include "vertex.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer {
+// Collapses edges by quadric error until the index buffer shrinks to the target size or no edge can be collapsed.
+// Vertices on borders and texture seams are locked, and every collapse keeps one of the existing vertices.
+std::vector<uint32_t> simplify(const std::vector<uint32_t>& index_buffer, const std::vector<Vertex>& vertex_buffer, size_t target_index_count);
+}
@@ -2,6 +2,8 @@
 
 #include "matrix.h"
 
+#include <cstdint>
+
 namespace renderer {
 struct Vertex {
     union {
@@ -18,4 +20,9 @@ struct Vertex {
     float u;
     float v;
 };
+
+struct TransformedVertex {
+    Vertex vertex;
+    uint8_t clip_code;
+};
 }
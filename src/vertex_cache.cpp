@@ -0,0 +1,169 @@
+#include "vertex_cache.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+namespace renderer {
+namespace {
+constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+struct Adjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+Adjacency build_adjacency(const std::vector<uint32_t>& indices, size_t vertex_count) {
+    Adjacency adjacency;
+    adjacency.offsets.resize(vertex_count + 1, 0);
+    for (uint32_t index : indices) {
+        adjacency.offsets[index + 1]++;
+    }
+    for (size_t vertex = 0; vertex < vertex_count; vertex++) {
+        adjacency.offsets[vertex + 1] += adjacency.offsets[vertex];
+    }
+
+    adjacency.triangles.resize(indices.size());
+    std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency.triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+    return adjacency;
+}
+
+uint32_t skip_dead_end(std::vector<uint32_t>& dead_ends, const std::vector<uint32_t>& live_triangles, uint32_t& cursor) {
+    while (!dead_ends.empty()) {
+        const uint32_t vertex = dead_ends.back();
+        dead_ends.pop_back();
+        if (live_triangles[vertex] > 0) {
+            return vertex;
+        }
+    }
+
+    while (cursor < live_triangles.size()) {
+        if (live_triangles[cursor] > 0) {
+            return cursor;
+        }
+        cursor++;
+    }
+    return INVALID_INDEX;
+}
+}
+
+float get_acmr(const uint32_t* indices, size_t index_count, size_t cache_size) {
+    if (index_count < 3) {
+        return 0.f;
+    }
+
+    std::vector<uint32_t> cache(cache_size, INVALID_INDEX);
+    size_t cache_head = 0;
+    size_t misses = 0;
+    for (size_t i = 0; i < index_count; i++) {
+        if (std::find(cache.begin(), cache.end(), indices[i]) == cache.end()) {
+            cache[cache_head] = indices[i];
+            cache_head = (cache_head + 1) % cache_size;
+            misses++;
+        }
+    }
+    return static_cast<float>(misses) / (index_count / 3);
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t cache_size) {
+    // Vertices are renumbered locally so that the cost only depends on the size of the range
+    std::unordered_map<uint32_t, uint32_t> local_ids;
+    std::vector<uint32_t> global_ids;
+    std::vector<uint32_t> local_indices(index_count);
+    for (size_t i = 0; i < index_count; i++) {
+        auto it = local_ids.emplace(indices[i], static_cast<uint32_t>(global_ids.size())).first;
+        if (it->second == global_ids.size()) {
+            global_ids.push_back(indices[i]);
+        }
+        local_indices[i] = it->second;
+    }
+
+    const size_t vertex_count = global_ids.size();
+    const Adjacency adjacency = build_adjacency(local_indices, vertex_count);
+
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for (size_t vertex = 0; vertex < vertex_count; vertex++) {
+        live_triangles[vertex] = adjacency.offsets[vertex + 1] - adjacency.offsets[vertex];
+    }
+
+    std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+    std::vector<bool> emitted(index_count / 3, false);
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+
+    uint32_t timestamp = static_cast<uint32_t>(cache_size) + 1;
+    uint32_t cursor = 0;
+    uint32_t fanning_vertex = vertex_count > 0 ? 0 : INVALID_INDEX;
+    while (fanning_vertex != INVALID_INDEX) {
+        candidates.clear();
+
+        for (uint32_t i = adjacency.offsets[fanning_vertex]; i < adjacency.offsets[fanning_vertex + 1]; i++) {
+            const uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (size_t corner = 0; corner < 3; corner++) {
+                const uint32_t vertex = local_indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_ends.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+                if (timestamp - cache_timestamps[vertex] > cache_size) {
+                    cache_timestamps[vertex] = timestamp++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that will still be in the cache once all of its remaining triangles are emitted
+        fanning_vertex = INVALID_INDEX;
+        int64_t best_priority = -1;
+        for (uint32_t vertex : candidates) {
+            if (live_triangles[vertex] == 0) {
+                continue;
+            }
+
+            int64_t priority = 0;
+            const int64_t age = timestamp - cache_timestamps[vertex];
+            if (age + 2 * live_triangles[vertex] <= static_cast<int64_t>(cache_size)) {
+                priority = age;
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                fanning_vertex = vertex;
+            }
+        }
+
+        if (fanning_vertex == INVALID_INDEX) {
+            fanning_vertex = skip_dead_end(dead_ends, live_triangles, cursor);
+        }
+    }
+
+    for (size_t i = 0; i < index_count; i++) {
+        indices[i] = global_ids[output[i]];
+    }
+}
+
+void optimize_vertex_fetch(const std::vector<std::vector<uint32_t>*>& index_buffers, std::vector<Vertex>& vertex_buffer) {
+    std::vector<uint32_t> remap(vertex_buffer.size(), INVALID_INDEX);
+    std::vector<Vertex> ordered_buffer;
+    ordered_buffer.reserve(vertex_buffer.size());
+
+    for (std::vector<uint32_t>* index_buffer : index_buffers) {
+        for (uint32_t& index : *index_buffer) {
+            if (remap[index] == INVALID_INDEX) {
+                remap[index] = static_cast<uint32_t>(ordered_buffer.size());
+                ordered_buffer.push_back(vertex_buffer[index]);
+            }
+            index = remap[index];
+        }
+    }
+    vertex_buffer.swap(ordered_buffer);
+}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "vertex.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer {
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+
+// Average number of vertices missing a FIFO post-transform cache per triangle, from 0.5 (ideal) to 3
+float get_acmr(const uint32_t* indices, size_t index_count, size_t cache_size);
+// Reorders triangles with the Tipsify algorithm to improve post-transform cache reuse
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t cache_size);
+// Reorders vertices in the order of their first use to improve fetch locality, visiting the index buffers in the given order
+void optimize_vertex_fetch(const std::vector<std::vector<uint32_t>*>& index_buffers, std::vector<Vertex>& vertex_buffer);
+}